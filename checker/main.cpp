@@ -16,7 +16,11 @@
 
 #include "leviathan.hpp"
 
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
 #include <fstream>
+#include <memory>
 #include <limits>
 #include <string>
 #include <vector>
@@ -134,11 +138,111 @@ static TCLAP::ValueArg<uint64_t> depth(
   "The maximum depth to descend into the tableaux (aka the maximum size of "
   "the model)",
   false, std::numeric_limits<uint64_t>::max(), "number");
+
+static TCLAP::ValueArg<uint32_t> threads(
+  "", "threads",
+  "The number of threads exploring the tableau in parallel. Idle threads "
+  "steal unexplored branches from the busy ones",
+  false, 1, "number");
+
+static TCLAP::ValueArg<uint32_t> cache_size(
+  "", "cache-size",
+  "The megabytes of memory each thread may use to remember the subtrees "
+  "found closed by contradictions, so as not to explore them again. Zero "
+  "disables the cache",
+  false, 64, "number");
+
+static std::vector<std::string> branchings = {"fixed", "fewest-new",
+                                              "eventualities", "activity"};
+static TCLAP::ValuesConstraint<std::string> branchings_constraint(branchings);
+
+static TCLAP::ValueArg<std::string> branching(
+  "", "branching",
+  "Which pending disjunction, eventually, until or release formula to branch "
+  "on first: the first by kind and index (fixed), the one adding the fewest "
+  "new formulas (fewest-new), the eventualities still to be satisfied "
+  "(eventualities), or the one most often chosen before a contradiction "
+  "(activity)",
+  false, "fixed", &branchings_constraint);
+
+static TCLAP::SwitchArg lookahead(
+  "", "lookahead",
+  "Before branching on a formula, tries each alternative with the rules that "
+  "do not branch, and takes without a choice the only one that does not lead "
+  "to a contradiction",
+  false);
+
+static TCLAP::SwitchArg learning(
+  "", "learning",
+  "When a contradiction is found, goes back straight to the latest choice "
+  "that led to it in the same state, and remembers the alternatives that "
+  "led to it so as to notice them at once when taken together again",
+  false);
+
+static TCLAP::SwitchArg sat(
+  "", "sat",
+  "Expands each state at once with a SAT solver, enumerating the consistent "
+  "sets of formulas of the state instead of branching on the rules",
+  false);
+
+static TCLAP::SwitchArg portfolio(
+  "", "portfolio",
+  "Races a solver for each branching policy on separate threads, and "
+  "answers with the first one to finish",
+  false);
+
+static TCLAP::ValueArg<uint32_t> estimate(
+  "", "estimate",
+  "Instead of solving the formula, estimates the size of its tableau with "
+  "the given number of random descents, and the split depth and number of "
+  "jobs to give to JOB_NO",
+  false, 0, "probes");
+
+static TCLAP::ValueArg<std::string> stats(
+  "", "stats",
+  "Appends the statistics of the solver on each formula to the given file, "
+  "as a JSON object per line",
+  false, "", "path");
+
+static TCLAP::ValueArg<std::string> checkpoint(
+  "", "checkpoint",
+  "Saves the state of the search to the given file every "
+  "--checkpoint-interval frames, and when interrupted by SIGINT, SIGTERM or "
+  "SIGXCPU, so that --resume can continue it later. With a file of several "
+  "formulas, each one is saved to its own file, the path followed by a dot "
+  "and the line number of the formula",
+  false, "", "path");
+
+static TCLAP::ValueArg<uint64_t> checkpoint_interval(
+  "", "checkpoint-interval",
+  "The number of frames between two checkpoints. Zero saves the search only "
+  "when interrupted",
+  false, 0, "number");
+
+static TCLAP::ValueArg<std::string> resume(
+  "", "resume",
+  "Continues the search saved to the given file by --checkpoint, for the "
+  "same formula and options, and keeps saving it there unless --checkpoint "
+  "says otherwise. With a file of several formulas, each one is continued "
+  "from its own file as named by --checkpoint, those without one from "
+  "scratch",
+  false, "", "path");
 }
 
-void solve(std::string const &, optional<size_t> current = nullopt);
+// Raised by the signals that stop a search saving a checkpoint
+static std::atomic<bool> interrupted(false);
+
+static void interrupt(int) { interrupted = true; }
+
+// The number of formulas of the input: when there are several, each one has
+// its own checkpoint
+static size_t number_of_formulas = 1;
+
+bool solve(std::string const &, optional<size_t> current = nullopt);
+void print_estimate(LTL::Solver &solver);
+void write_stats(LTL::Solver const &, size_t);
 void print_progress_status(LTL::FormulaPtr const&, size_t);
-void batch(std::string const &);
+bool batch(std::string const &);
 void parse(std::string const&formula);
 
 // We suppose 80 columns is a good width
@@ -166,7 +270,8 @@ void print_progress_status(LTL::FormulaPtr const& f, size_t current)
   format::message("{}{}{}", msg, formula, ellipses);
 }
 
-void solve(const std::string &input, optional<size_t> current)
+// Returns true if the formula is satisfiable
+bool solve(const std::string &input, optional<size_t> current)
 {
   std::stringstream stream(input);
   LTL::Parser parser(stream, [&](std::string err) {
@@ -177,16 +282,88 @@ void solve(const std::string &input, optional<size_t> current)
 
   LTL::FormulaPtr formula = parser.parseFormula();
   if (!formula)
-    return;
+    return false;
 
   if (current)
     print_progress_status(formula, *current);
 
-  LTL::Solver solver(formula, LTL::FrameID(Args::depth.getValue()));
+  LTL::Solver::Options options;
+  options.maximum_depth = LTL::FrameID(Args::depth.getValue());
+  options.threads = Args::threads.getValue();
+  options.cache_size = Args::cache_size.getValue();
+  options.branching = LTL::Solver::Branching(
+    std::find(Args::branchings.begin(), Args::branchings.end(),
+              Args::branching.getValue()) -
+    Args::branchings.begin());
+  options.lookahead = Args::lookahead.isSet();
+  options.learning = Args::learning.isSet();
+  options.sat = Args::sat.isSet();
+
+  // Named after the line of the formula, when the file has several
+  auto checkpoint_of = [&current](const std::string &path) {
+    return path.empty() || number_of_formulas == 1
+             ? path
+             : format::format("{}.{}", path, current.value_or(1));
+  };
+  options.checkpoint =
+    checkpoint_of(Args::checkpoint.isSet() ? Args::checkpoint.getValue()
+                                           : Args::resume.getValue());
+  options.checkpoint_interval = Args::checkpoint_interval.getValue();
+  options.resume = checkpoint_of(Args::resume.getValue());
+
+  // The formulas an interrupted run did not get to were never saved
+  if (number_of_formulas > 1 && !options.resume.empty() &&
+      !std::ifstream(options.resume))
+    options.resume.clear();
+
+  if (!options.checkpoint.empty())
+    options.stop = &interrupted;
+
+  if (Args::estimate.isSet()) {
+    LTL::Solver solver(formula, options);
+    print_estimate(solver);
+    return false;
+  }
+
+  // Whichever of the two is used owns the solver that gives the answer
+  std::unique_ptr<LTL::Solver> single;
+  std::unique_ptr<LTL::Portfolio> portfolio;
+  LTL::Solver *solver = nullptr;
 
-  solver.solution();
+  if (Args::portfolio.isSet() && !getenv("JOB_NO")) {
+    portfolio.reset(new LTL::Portfolio(
+      formula, LTL::Portfolio::configurations(options)));
+    portfolio->solution();
+
+    solver = portfolio->winner();
+    if (solver)
+      format::verbose("Answer given by configuration n° {} of the portfolio",
+                      portfolio->winner_index() + 1);
+  }
+  else {
+    single.reset(new LTL::Solver(formula, options));
+    single->solution();
+    solver = single.get();
+  }
+
+  // The search was interrupted, e.g. because another job found a model
+  if (!solver ||
+      solver->satisfiability() == LTL::Solver::Result::UNDEFINED) {
+    if (Args::parsable.isSet())
+      format::message("UNKNOWN");
+    else
+      format::message("The satisfiability of the formula is unknown!");
+
+    if (interrupted && !options.checkpoint.empty() &&
+        !Args::parsable.isSet())
+      format::message("The search can be continued with --resume {}",
+                      options.checkpoint);
+    if (solver)
+      write_stats(*solver, current.value_or(1));
+    return false;
+  }
 
-  bool sat = solver.satisfiability() == LTL::Solver::Result::SATISFIABLE;
+  bool sat = solver->satisfiability() == LTL::Solver::Result::SATISFIABLE;
 
   if (Args::parsable.isSet())
     format::message(format::NoNewLine, "{}",
@@ -197,7 +374,7 @@ void solve(const std::string &input, optional<size_t> current)
       sat ? colored(Green, "satisfiable") : colored(Red, "unsatisfiable"));
 
   if (sat && Args::model.isSet()) {
-    LTL::ModelPtr model = solver.model();
+    LTL::ModelPtr model = solver->model();
 
     if (!Args::parsable.isSet())
       format::message("\nThe following model was found:");
@@ -207,9 +384,53 @@ void solve(const std::string &input, optional<size_t> current)
                     model_format(model, Args::parsable.isSet()));
   }
   format::newline(format::Message);
+
+  write_stats(*solver, current.value_or(1));
+
+  return sat;
+}
+
+void write_stats(LTL::Solver const &solver, size_t current)
+{
+  if (!Args::stats.isSet())
+    return;
+
+  static const char *const results[] = {"unknown", "sat", "unsat"};
+  std::ofstream file(Args::stats.getValue(), std::ios::app);
+  file << format::format(
+    "{{\"formula\":{},\"result\":\"{}\",\"stats\":{}}}\n", current,
+    results[static_cast<size_t>(solver.satisfiability())],
+    solver.stats().json());
+
+  if (!file)
+    format::error("Unable to write the statistics to \"{}\"",
+                  Args::stats.getValue());
+}
+
+void print_estimate(LTL::Solver &solver)
+{
+  // Split for the jobs of JOB_NO, if given
+  uint32_t job_no = 0, jobs = 0;
+  if (getenv("JOB_NO"))
+    sscanf(getenv("JOB_NO"), "%u/%u", &job_no, &jobs);
+
+  LTL::Solver::Estimate estimate =
+    solver.estimate(Args::estimate.getValue(), jobs);
+
+  std::string width;
+  for (size_t d = 1; d < estimate.width.size(); ++d)
+    width += format::format("{}:{:.3g} ", d, estimate.width[d]);
+
+  format::message("Estimated size: {:.3g} frames, {:.3g} s with one job",
+                  estimate.frames, estimate.seconds);
+  format::message("Estimated width: {}", width);
+  format::message("Suggested split: JOB_NO=i/{}@{}, {:.3g} s per job",
+                  estimate.jobs, estimate.split_depth,
+                  estimate.seconds / estimate.jobs);
 }
 
-void batch(std::string const &filename)
+// Returns true if any of the formulas is satisfiable
+bool batch(std::string const &filename)
 {
   std::ifstream file(filename, std::ios::in);
 
@@ -220,12 +441,18 @@ void batch(std::string const &filename)
     format::fatal("Unable to open the file \"{}\": {}", filename, error_msg);
   }
 
+  // All read first, for their checkpoints to be named after how many there are
+  std::vector<std::string> lines;
   std::string line;
-  size_t line_number = 1;
-  while (std::getline(file, line)) {
-    solve(line, line_number);
-    ++line_number;
-  }
+  while (std::getline(file, line))
+    lines.push_back(line);
+  number_of_formulas = lines.size();
+
+  bool sat = false;
+  for (size_t i = 0; i < lines.size() && !interrupted; ++i)
+    sat |= solve(lines[i], i + 1);
+
+  return sat;
 }
 
 int main(int argc, char *argv[])
@@ -236,6 +463,18 @@ int main(int argc, char *argv[])
   using namespace Args;
 
   cmd.add(depth);
+  cmd.add(threads);
+  cmd.add(cache_size);
+  cmd.add(branching);
+  cmd.add(lookahead);
+  cmd.add(learning);
+  cmd.add(sat);
+  cmd.add(Args::portfolio);
+  cmd.add(Args::estimate);
+  cmd.add(Args::stats);
+  cmd.add(checkpoint);
+  cmd.add(checkpoint_interval);
+  cmd.add(resume);
   cmd.add(verbosity);
   cmd.add(parsable);
   cmd.add(model);
@@ -250,11 +489,30 @@ int main(int argc, char *argv[])
 
   // format::verbose("Verbose message. I told you this would be very verbose.");
 
+  if (Args::portfolio.isSet() && getenv("JOB_NO"))
+    format::error("--portfolio is ignored when running with JOB_NO");
+
+  // Interrupting a search that saves checkpoints saves a last one
+  if (checkpoint.isSet() || resume.isSet()) {
+    std::signal(SIGINT, interrupt);
+    std::signal(SIGTERM, interrupt);
+#ifdef SIGXCPU
+    std::signal(SIGXCPU, interrupt);
+#endif
+  }
+
   // Begin to process inputs
+  bool sat = false;
   if (ltl.isSet())
-    solve(ltl.getValue(), 1);
+    sat = solve(ltl.getValue(), 1);
   else
-    batch(filename.getValue());
+    sat = batch(filename.getValue());
+
+  // Scripts tell satisfiable formulas apart by the exit code, 5 unless
+  // LV_SAT_ERRCODE says otherwise
+  if (!sat)
+    return 0;
 
-  return 0;
+  const char *sat_errcode = getenv("LV_SAT_ERRCODE");
+  return sat_errcode ? atoi(sat_errcode) : 5;
 }
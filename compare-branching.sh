@@ -0,0 +1,55 @@
+#!/bin/bash
+
+#
+# This script runs the checker on every test of tests.index once for each
+# branching policy, and prints for each family of benchmarks (the first two
+# directories under tests/) how many frames each policy built and how many
+# tests it did not solve in time.
+#
+# Usage: ./compare-branching.sh [checker] [timeout in seconds]
+#
+
+die() {
+  echo \
+This script must be executed from the root directory of leviathan\'s source \
+tree. 1>&2
+  exit 1
+}
+
+# Check that we run from the topmost source dir
+[ -d .git ] || die
+
+checker=${1:-bin/checker}
+seconds=${2:-3}
+policies="fixed fewest-new eventualities activity"
+
+for policy in $policies; do
+  while IFS=";" read -r filename result; do
+    output=$(timeout ${seconds}s $checker -v 4 --branching $policy $filename 2>&1)
+    frames=$(echo "$output" | sed -n 's/.*Total frames: \([0-9]*\).*/\1/p')
+    family=$(echo $filename | cut -d/ -f2-3)
+
+    echo "$family $policy ${frames:--}"
+  done < tests/tests.index
+done | awk -v policies="$policies" '
+  {
+    families[$1] = 1
+    if ($3 == "-")
+      timeouts[$1, $2]++
+    else
+      frames[$1, $2] += $3
+  }
+  END {
+    n = split(policies, p, " ")
+    printf "%-30s", "family"
+    for (i = 1; i <= n; ++i)
+      printf " %22s", p[i]
+    printf "\n"
+
+    for (f in families) {
+      printf "%-30s", f
+      for (i = 1; i <= n; ++i)
+        printf " %14d (%3d TO)", frames[f, p[i]], timeouts[f, p[i]]
+      printf "\n"
+    }
+  }'
@@ -0,0 +1,300 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace LTL {
+namespace detail {
+
+inline size_t count_trailing_zeros(uint64_t word)
+{
+  assert(word != 0);
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward64(&index, word);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctzll(word));
+#endif
+}
+
+inline size_t count_ones(uint64_t word)
+{
+#ifdef _MSC_VER
+  return static_cast<size_t>(__popcnt64(word));
+#else
+  return static_cast<size_t>(__builtin_popcountll(word));
+#endif
+}
+
+/*
+ * Operations shared by the bitsets of every width. They only go through
+ * words() and num_words() of the derived class, so that with a compile-time
+ * number of words every loop below is fully unrolled.
+ *
+ * Unlike boost::dynamic_bitset, the size is always a whole number of words:
+ * set() turns on the padding bits past the last formula too. They never reach
+ * the formulas of a frame, which are only ever set one by one.
+ */
+template <typename Derived>
+class BitsetBase {
+public:
+  static constexpr size_t bits_per_word = 64;
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  class reference {
+  public:
+    reference(uint64_t &word, uint64_t mask) : _word(word), _mask(mask) {}
+
+    reference &operator=(bool value)
+    {
+      if (value)
+        _word |= _mask;
+      else
+        _word &= ~_mask;
+      return *this;
+    }
+
+    operator bool() const { return (_word & _mask) != 0; }
+
+  private:
+    uint64_t &_word;
+    uint64_t _mask;
+  };
+
+  size_t size() const { return self().num_words() * bits_per_word; }
+
+  bool test(size_t pos) const
+  {
+    assert(pos < size());
+    return (self().words()[pos / bits_per_word] >> (pos % bits_per_word)) & 1;
+  }
+
+  bool operator[](size_t pos) const { return test(pos); }
+
+  reference operator[](size_t pos)
+  {
+    assert(pos < size());
+    return reference(self().words()[pos / bits_per_word],
+                     uint64_t(1) << (pos % bits_per_word));
+  }
+
+  Derived &set(size_t pos)
+  {
+    assert(pos < size());
+    self().words()[pos / bits_per_word] |= uint64_t(1) << (pos % bits_per_word);
+    return self();
+  }
+
+  Derived &reset(size_t pos)
+  {
+    assert(pos < size());
+    self().words()[pos / bits_per_word] &=
+      ~(uint64_t(1) << (pos % bits_per_word));
+    return self();
+  }
+
+  Derived &set()
+  {
+    for (size_t i = 0; i < self().num_words(); ++i)
+      self().words()[i] = ~uint64_t(0);
+    return self();
+  }
+
+  Derived &reset()
+  {
+    for (size_t i = 0; i < self().num_words(); ++i)
+      self().words()[i] = 0;
+    return self();
+  }
+
+  bool any() const
+  {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < self().num_words(); ++i)
+      acc |= self().words()[i];
+    return acc != 0;
+  }
+
+  bool none() const { return !any(); }
+
+  size_t count() const
+  {
+    size_t result = 0;
+    for (size_t i = 0; i < self().num_words(); ++i)
+      result += count_ones(self().words()[i]);
+    return result;
+  }
+
+  size_t find_first() const
+  {
+    return self().num_words() ? _find_from(0, self().words()[0]) : npos;
+  }
+
+  // Position of the first bit set after pos, or npos
+  size_t find_next(size_t pos) const
+  {
+    size_t word = ++pos / bits_per_word;
+    if (word >= self().num_words())
+      return npos;
+
+    uint64_t mask = ~uint64_t(0) << (pos % bits_per_word);
+    return _find_from(word, self().words()[word] & mask);
+  }
+
+  Derived &operator&=(const Derived &other)
+  {
+    assert(self().num_words() == other.num_words());
+    for (size_t i = 0; i < self().num_words(); ++i)
+      self().words()[i] &= other.words()[i];
+    return self();
+  }
+
+  Derived &operator|=(const Derived &other)
+  {
+    assert(self().num_words() == other.num_words());
+    for (size_t i = 0; i < self().num_words(); ++i)
+      self().words()[i] |= other.words()[i];
+    return self();
+  }
+
+  Derived &operator>>=(size_t shift)
+  {
+    const size_t n = self().num_words();
+    const size_t words = shift / bits_per_word;
+    const size_t bits = shift % bits_per_word;
+    uint64_t *w = self().words();
+
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t low = i + words < n ? w[i + words] : 0;
+      uint64_t high = i + words + 1 < n ? w[i + words + 1] : 0;
+      w[i] = bits ? (low >> bits) | (high << (bits_per_word - bits)) : low;
+    }
+
+    return self();
+  }
+
+  friend bool operator==(const Derived &a, const Derived &b)
+  {
+    if (a.num_words() != b.num_words())
+      return false;
+
+    uint64_t diff = 0;
+    for (size_t i = 0; i < a.num_words(); ++i)
+      diff |= a.words()[i] ^ b.words()[i];
+    return diff == 0;
+  }
+
+  friend bool operator!=(const Derived &a, const Derived &b)
+  {
+    return !(a == b);
+  }
+
+private:
+  Derived &self() { return static_cast<Derived &>(*this); }
+  const Derived &self() const { return static_cast<const Derived &>(*this); }
+
+  size_t _find_from(size_t word, uint64_t bits) const
+  {
+    while (!bits) {
+      if (++word >= self().num_words())
+        return npos;
+      bits = self().words()[word];
+    }
+
+    return word * bits_per_word + count_trailing_zeros(bits);
+  }
+};
+
+template <typename Derived>
+constexpr size_t BitsetBase<Derived>::bits_per_word;
+
+template <typename Derived>
+constexpr size_t BitsetBase<Derived>::npos;
+
+/*
+ * Bitset stored inline in Words 64-bit words, used for the frames of the
+ * closures small enough to fit. Bitset<0> is the fallback for the bigger ones,
+ * sized at runtime.
+ */
+template <size_t Words>
+class Bitset : public BitsetBase<Bitset<Words>> {
+public:
+  explicit Bitset(size_t size = 0) : _words()
+  {
+    (void)size;
+    assert(size <= Words * BitsetBase<Bitset>::bits_per_word);
+  }
+
+  // Copies the words of a bitset of another width, which must fit
+  template <size_t Other>
+  explicit Bitset(const Bitset<Other> &other) : _words()
+  {
+    assert(other.num_words() <= Words);
+    std::copy_n(other.words(), std::min(Words, other.num_words()),
+                _words.begin());
+  }
+
+  static constexpr size_t num_words() { return Words; }
+  uint64_t *words() { return _words.data(); }
+  const uint64_t *words() const { return _words.data(); }
+
+private:
+  std::array<uint64_t, Words> _words;
+};
+
+template <>
+class Bitset<0> : public BitsetBase<Bitset<0>> {
+public:
+  explicit Bitset(size_t size = 0)
+    : _words((size + bits_per_word - 1) / bits_per_word)
+  {
+  }
+
+  template <size_t Other>
+  explicit Bitset(const Bitset<Other> &other)
+    : _words(other.words(), other.words() + other.num_words())
+  {
+  }
+
+  void resize(size_t size)
+  {
+    _words.resize((size + bits_per_word - 1) / bits_per_word);
+  }
+
+  size_t num_words() const { return _words.size(); }
+  uint64_t *words() { return _words.data(); }
+  const uint64_t *words() const { return _words.data(); }
+
+private:
+  std::vector<uint64_t> _words;
+};
+
+using DynamicBitset = Bitset<0>;
+}
+}
@@ -0,0 +1,239 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "bitset.hpp"
+#include "identifiable.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace LTL {
+namespace detail {
+
+// TODO: Remove set_ and is_ from functions name
+class Eventuality {
+public:
+  Eventuality() : _id(NOT_REQUESTED) {}
+  Eventuality(FrameID id) : _id(id) {}
+  FrameID &id() { return _id; }
+  FrameID id() const { return _id; }
+  bool is_not_requested() const { return _id == FrameID(NOT_REQUESTED); }
+  bool is_not_satisfied() const { return _id == FrameID(NOT_SATISFIED); }
+  bool is_satisfied() const { return _id < FrameID(NOT_SATISFIED); }
+  void set_not_requested() { _id = FrameID(NOT_REQUESTED); }
+  void set_not_satisfied() { _id = FrameID(NOT_SATISFIED); }
+  void set_satisfied(const FrameID &id) { _id = id; }
+
+  static Eventuality not_requested() { return Eventuality(); }
+  static Eventuality not_satisfied()
+  {
+    return Eventuality(FrameID(NOT_SATISFIED));
+  }
+  static Eventuality satisfied(const FrameID &id) { return Eventuality(id); }
+
+private:
+  FrameID _id;
+
+  static constexpr uint64_t NOT_REQUESTED =
+    std::numeric_limits<uint64_t>::max();
+  static constexpr uint64_t NOT_SATISFIED =
+    std::numeric_limits<uint64_t>::max() - 1;
+};
+
+/*
+ * The eventualities of a frame, stored by columns: a "requested" and a
+ * "satisfied" bit for each of them, 32 to a word, and the 32-bit id of the
+ * frame where the satisfied ones were satisfied. Everything lives in a single
+ * block, so that copying the eventualities to a new frame is one copy.
+ * Eventuality is only the value read and written one at a time; the loop and
+ * prune rules work on whole words instead (see satisfied_after()).
+ *
+ * set() also keeps the number of unsatisfied and satisfied eventualities, and
+ * bounds on the ids of the satisfied ones, so that most frames pass or fail
+ * those rules without looking at the words at all.
+ *
+ * Plain std::allocator on purpose: a process-wide pool needs a mutex, which
+ * serializes the workers of a multi-threaded search
+ */
+class Eventualities {
+public:
+  using Word = uint32_t;
+  static constexpr size_t WORD_BITS = 32;
+
+  explicit Eventualities(size_t size = 0)
+    : _size(size),
+      _words(_num_words(size)),
+      _unsatisfied(0),
+      _satisfied(0),
+      _earliest(NONE),
+      _latest(0),
+      _data(_ids_offset() + _padded(size))
+  {
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  size_t num_words() const { return _words; }
+
+  // Const, so that nothing tries to write through Eventuality::id()
+  const Eventuality operator[](size_t i) const
+  {
+    assert(i < _size);
+    const Word bit = Word(1) << (i % WORD_BITS);
+
+    if (!(requested(i / WORD_BITS) & bit))
+      return Eventuality::not_requested();
+    if (!(satisfied(i / WORD_BITS) & bit))
+      return Eventuality::not_satisfied();
+    return Eventuality::satisfied(FrameID(_data[_ids_offset() + i]));
+  }
+
+  void set(size_t i, Eventuality ev)
+  {
+    assert(i < _size);
+    const Word bit = Word(1) << (i % WORD_BITS);
+    Word &requested = _data[i / WORD_BITS];
+    Word &satisfied = _data[_words + i / WORD_BITS];
+
+    if (satisfied & bit)
+      --_satisfied;
+    else if (requested & bit)
+      --_unsatisfied;
+
+    if (ev.is_not_requested()) {
+      requested &= ~bit;
+      satisfied &= ~bit;
+    }
+    else if (ev.is_not_satisfied()) {
+      requested |= bit;
+      satisfied &= ~bit;
+      ++_unsatisfied;
+    }
+    else {
+      assert(uint64_t(ev.id()) < NONE);
+      const uint32_t id = uint32_t(ev.id());
+      requested |= bit;
+      satisfied |= bit;
+      _data[_ids_offset() + i] = id;
+      ++_satisfied;
+      _earliest = std::min(_earliest, id);
+      _latest = std::max(_latest, id);
+    }
+
+    // The bounds only ever widen while something stays satisfied
+    if (_satisfied == 0) {
+      _earliest = NONE;
+      _latest = 0;
+    }
+  }
+
+  // Requested and not satisfied yet
+  size_t unsatisfied_count() const { return _unsatisfied; }
+  size_t satisfied_count() const { return _satisfied; }
+
+  // Every satisfied eventuality was satisfied in a frame with an id in
+  // [earliest(), latest()]. Only meaningful if satisfied_count() > 0
+  FrameID earliest() const { return FrameID(_earliest); }
+  FrameID latest() const { return FrameID(_latest); }
+
+  Word requested(size_t word) const { return _data[word]; }
+  Word satisfied(size_t word) const { return _data[_words + word]; }
+
+  // The eventualities of the given word satisfied in a frame after the one
+  // with the given id
+  Word satisfied_after(size_t word, FrameID id) const
+  {
+    const Word satisfied = this->satisfied(word);
+    if (!satisfied || uint64_t(id) >= NONE)
+      return 0;
+
+    const uint32_t *ids = &_data[_ids_offset() + word * WORD_BITS];
+    const uint32_t threshold = uint32_t(id);
+    Word later = 0;
+
+#ifdef __AVX2__
+    // There is no unsigned comparison: flip the sign bits and compare signed.
+    // The ids are padded to whole lanes of 8
+    const size_t count = std::min(_size - word * WORD_BITS, size_t(WORD_BITS));
+    const size_t lanes = (count + 7) / 8;
+    const __m256i sign = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+    const __m256i limit = _mm256_set1_epi32(int32_t(threshold ^ 0x80000000u));
+    for (size_t k = 0; k < lanes; ++k) {
+      const __m256i lane = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ids + 8 * k)),
+        sign);
+      const int gt = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(lane, limit)));
+      later |= Word(gt) << (8 * k);
+    }
+#else
+    // Only the satisfied ones have a meaningful id, and they are usually few
+    for (Word bits = satisfied; bits; bits &= bits - 1) {
+      const size_t j = count_trailing_zeros(bits);
+      later |= Word(ids[j] > threshold) << j;
+    }
+#endif
+
+    return satisfied & later;
+  }
+
+  // The step rule: the satisfied eventualities are not requested anymore
+  void forget_satisfied()
+  {
+    for (size_t w = 0; w < _words; ++w) {
+      _data[w] &= ~_data[_words + w];
+      _data[_words + w] = 0;
+    }
+
+    _satisfied = 0;
+    _earliest = NONE;
+    _latest = 0;
+  }
+
+private:
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  size_t _size;
+  size_t _words;
+  uint32_t _unsatisfied;
+  uint32_t _satisfied;
+  uint32_t _earliest;
+  uint32_t _latest;
+
+  // The requested words, the satisfied ones, then the ids, padded to a
+  // multiple of 8 for the kernels
+  std::vector<uint32_t> _data;
+
+  static size_t _num_words(size_t size)
+  {
+    return (size + WORD_BITS - 1) / WORD_BITS;
+  }
+
+  static size_t _padded(size_t size) { return (size + 7) / 8 * 8; }
+
+  size_t _ids_offset() const { return 2 * _words; }
+};
+}
+}
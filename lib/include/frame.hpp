@@ -16,55 +16,39 @@
 
 #pragma once
 
-#include "boost/dynamic_bitset.hpp"
-#include "boost/pool/pool_alloc.hpp"
+#include "bitset.hpp"
+#include "eventualities.hpp"
 #include "identifiable.hpp"
 
 #include <cstdint>
+#include <vector>
 
 namespace LTL {
 namespace detail {
 
-using Bitset = boost::dynamic_bitset<uint64_t>;
-
-// TODO: Remove set_ and is_ from functions name
-class Eventuality {
-public:
-  Eventuality() : _id(NOT_REQUESTED) {}
-  Eventuality(FrameID id) : _id(id) {}
-  FrameID &id() { return _id; }
-  FrameID id() const { return _id; }
-  bool is_not_requested() const { return _id == FrameID(NOT_REQUESTED); }
-  bool is_not_satisfied() const { return _id == FrameID(NOT_SATISFIED); }
-  bool is_satisfied() const { return _id < FrameID(NOT_SATISFIED); }
-  void set_not_requested() { _id = FrameID(NOT_REQUESTED); }
-  void set_not_satisfied() { _id = FrameID(NOT_SATISFIED); }
-  void set_satisfied(const FrameID &id) { _id = id; }
-private:
-  FrameID _id;
-
-  static constexpr uint64_t NOT_REQUESTED =
-    std::numeric_limits<uint64_t>::max();
-  static constexpr uint64_t NOT_SATISFIED =
-    std::numeric_limits<uint64_t>::max() - 1;
-};
-
-using Eventualities =
-  std::vector<Eventuality, boost::fast_pool_allocator<Eventuality>>;
-
-struct Frame {
+// Shared by the frames of every width, see Frame
+struct FrameBase {
   enum Type : uint8_t { UNKNOWN = 0, STEP = 1, CHOICE = 2 };
+};
 
-  Bitset formulas;
-  Bitset to_process;
+// A tableau node, with the formulas stored in Words 64-bit words (or sized at
+// runtime when Words is zero, see Bitset)
+template <size_t Words>
+struct Frame : FrameBase {
+  Bitset<Words> formulas;
+  Bitset<Words> to_process;
   Eventualities eventualities;
   FrameID id;
-  FormulaID choosen_formula;
   Frame* chain;
   Frame* first;
   Frame* prev;
   Type type;
 
+  // Zobrist hash of the formulas, kept up to date by the tableau, and the
+  // closest state below in the same bucket of its history
+  uint64_t hash;
+  Frame* same_bucket;
+
   // Builds a frame with a single formula in it (represented by the index in
   // the table) -> Start of the process
   Frame(const FrameID _id, const FormulaID _formula,
@@ -73,29 +57,49 @@ struct Frame {
       to_process(number_of_formulas),
       eventualities(number_of_eventualities),
       id(_id),
-      choosen_formula(FormulaID::max()),
       chain(nullptr),
 	  first(nullptr),
 	  prev(nullptr),
-      type(UNKNOWN)
+      type(UNKNOWN),
+      hash(0),
+      same_bucket(nullptr)
   {
     formulas.set(_formula);
     to_process.set();
   }
 
-  // Builds a frame with the same formulas of the given frame in it -> Choice
-  // point
+  // Builds a frame with the same formulas of the given frame in it -> Snapshot
+  // of a choice point
   Frame(const Frame &_frame)
     : formulas(_frame.formulas),
       to_process(_frame.to_process),
-      eventualities(_frame.eventualities,
-                    _frame.eventualities.get_allocator()),
+      eventualities(_frame.eventualities),
       id(_frame.id),
-      choosen_formula(FormulaID::max()),
       chain(_frame.chain),
 	  first(nullptr),
 	  prev(nullptr),
-      type(UNKNOWN)
+      type(UNKNOWN),
+      hash(_frame.hash),
+      same_bucket(nullptr)
+  {
+  }
+
+  Frame(Frame &&) = default;
+
+  // Same as the copy, from a frame of a different width. Pointers to other frames
+  // cannot be carried over
+  template <size_t Other>
+  explicit Frame(const Frame<Other> &_frame)
+    : formulas(_frame.formulas),
+      to_process(_frame.to_process),
+      eventualities(_frame.eventualities),
+      id(_frame.id),
+      chain(nullptr),
+      first(nullptr),
+      prev(nullptr),
+      type(UNKNOWN),
+      hash(_frame.hash),
+      same_bucket(nullptr)
   {
   }
 
@@ -103,24 +107,51 @@ struct Frame {
   // filled with the formulas) -> Step rule
   Frame(const FrameID _id, uint64_t number_of_formulas,
         const Eventualities &_eventualities, Frame *chainPtr)
-    : formulas(number_of_formulas),
-      to_process(number_of_formulas),
-      eventualities(_eventualities, _eventualities.get_allocator()),
-      id(_id),
-      choosen_formula(FormulaID::max()),
-      chain(chainPtr),
-	  first(nullptr),
-	  prev(nullptr),
-      type(UNKNOWN)
+    : formulas(number_of_formulas), to_process(number_of_formulas)
+  {
+    assign(_id, number_of_formulas, _eventualities, chainPtr);
+  }
+
+  // Same as the copy constructor, reusing the memory of this frame
+  Frame &operator=(const Frame &_frame)
   {
+    formulas = _frame.formulas;
+    to_process = _frame.to_process;
+    eventualities = _frame.eventualities;
+    id = _frame.id;
+    chain = _frame.chain;
+    first = nullptr;
+    prev = nullptr;
+    type = UNKNOWN;
+    hash = _frame.hash;
+    same_bucket = nullptr;
+
+    return *this;
+  }
+
+  Frame &operator=(Frame &&) = default;
+
+  // Same as the step rule constructor, reusing the memory of this frame, which
+  // must have been built for as many formulas
+  void assign(const FrameID _id, uint64_t number_of_formulas,
+              const Eventualities &_eventualities, Frame *chainPtr)
+  {
+    (void)number_of_formulas;
+    assert(formulas.size() >= number_of_formulas);
+
+    formulas.reset();
     to_process.set();
+    eventualities = _eventualities;
+    id = _id;
+    chain = chainPtr;
+    first = nullptr;
+    prev = nullptr;
+    type = UNKNOWN;
+    hash = 0;
+    same_bucket = nullptr;
+
 	// TODO: Check if this is needed when we don't generate eventualities beforehand
-	std::for_each(eventualities.begin(), eventualities.end(),
-				  [&](Eventuality &ev)
-	{
-		if (ev.is_satisfied())
-			ev.set_not_requested();
-	});
+	eventualities.forget_satisfied();
   }
 };
 }
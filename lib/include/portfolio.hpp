@@ -0,0 +1,60 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "solver.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace LTL {
+namespace detail {
+
+/*
+ * Races solvers with different options on the same formula, each on its own
+ * thread. The first one to give a definitive answer wins, and the others are
+ * stopped through Solver::Options::stop.
+ */
+class Portfolio {
+public:
+  Portfolio(FormulaPtr formula,
+            const std::vector<Solver::Options> &configurations);
+
+  Portfolio(const Portfolio &) = delete;
+  Portfolio &operator=(const Portfolio &) = delete;
+
+  // A configuration per branching policy, the activity one with random
+  // initial scores, then more seeds of it, on top of the given options
+  static std::vector<Solver::Options>
+  configurations(const Solver::Options &base, size_t count = 4);
+
+  Solver::Result solution();
+
+  // The solver that found the answer, or nullptr until there is one
+  Solver *winner() const { return _winner; }
+
+  // Index of the configuration of the winner
+  size_t winner_index() const;
+
+private:
+  std::vector<std::unique_ptr<Solver>> _solvers;
+  std::atomic<bool> _stop;
+  Solver *_winner;
+};
+}
+}
@@ -17,26 +17,28 @@ permission.
 
 #pragma once
 
-#include "boost/pool/pool_alloc.hpp"
 #include "formula.hpp"
 #include "identifiable.hpp"
 #include "frame.hpp"
 #include "model.hpp"
 
+#include <atomic>
 #include <vector>
 #include <tuple>
 #include <limits>
-#include <stack>
-#include <queue>
+#include <memory>
+#include <string>
 #include <unordered_map>
-#include <random>
 
 namespace LTL
 {
 namespace detail
 {
 
-using Stack = std::stack<Frame, std::deque<Frame, boost::fast_pool_allocator<Frame>>>;
+class TableauBase;
+
+template <size_t Words, unsigned Features>
+class Tableau;
 
 class Solver
 {
@@ -57,18 +59,170 @@ public:
 		DONE
 	};
 
+	// Which pending disjunction, eventually, until or release formula of a
+	// state the tableau branches on first
+	enum class Branching : uint8_t
+	{
+		FIXED = 0,     // Disjunctions, eventually, until, release, by index
+		FEWEST_NEW,    // The one whose alternatives add the fewest formulas
+		EVENTUALITIES, // Eventually and until not yet satisfied before the rest
+		ACTIVITY       // The one most often chosen before a contradiction
+	};
+
+	// Processor cycles of the phases of the search, as read from the
+	// timestamp counter around each run of them. Only the builds with
+	// LEVIATHAN_PROFILE (cmake -DPROFILE_RULES=ON) time them, the others
+	// leave every histogram empty. Phases run within others, such as the
+	// rollbacks of lookahead in BETA, count in both.
+	struct Profile
+	{
+		enum Phase : uint8_t
+		{
+			SCAN = 0,      // _scan_rules()
+			ALPHA,         // _apply_alpha_rules()
+			BETA,          // Branching, with lookahead
+			CONTRADICTION, // _has_clash() on each new state
+			EVENTUALITIES, // _update_eventualities_satisfaction()
+			HISTORY,       // _update_history()
+			LOOP,          // _check_loop_rule()
+			PRUNE0,        // _check_prune0_rule()
+			PRUNE,         // _check_prune_rule()
+			CACHE,         // Looking up the crossed subtrees
+			STEP,          // _build_successor()
+			ROLLBACK,      // _rollback_to_latest_choice()
+			EXPANSION,     // _expand_state(), with Options::sat
+			NUMBER_OF_PHASES
+		};
+
+		// The runs of a phase by the cycles they took: buckets[i] counts
+		// those of 2^i cycles up to 2^(i+1) excluded, buckets[0] also
+		// those of none
+		struct Histogram
+		{
+			uint64_t runs = 0;
+			uint64_t cycles = 0;
+			uint64_t buckets[64] = {};
+		};
+
+		Histogram phases[NUMBER_OF_PHASES];
+
+		static const char* phase_name(Phase phase);
+
+		bool empty() const;
+		Profile& operator+=(const Profile& other);
+	};
+
+	// What the solver did, counted by each Solver on its own
 	struct Stats
 	{
+		// The rules of the tableau, as indices of rules
+		enum Rule : uint8_t
+		{
+			CONJUNCTION = 0,
+			ALWAYS,
+			DISJUNCTION,
+			EVENTUALLY,
+			UNTIL,
+			RELEASE,
+			STEP,
+			LOOP,
+			PRUNE0,
+			PRUNE,
+			NUMBER_OF_RULES
+		};
+
+		// Wall clock time of each phase of the solver
+		struct Timings
+		{
+			double simplification = 0;
+			double closure = 0;        // Subformulas and their bitsets
+			double tableau = 0;        // Building the tableau on them
+			double search = 0;         // Over every call to solution()
+			double model = 0;
+		};
+
 		uint64_t maximum_frames = 1;
 		uint64_t total_frames = 1;
 		uint64_t maximum_model_size = 1;
-		uint64_t current_model_size = 0; // TODO: Currently not implemented
+		uint64_t current_model_size = 0; // States of the last model built
+		// How the branches ended
 		uint64_t cross_by_contradiction = 0;
 		uint64_t cross_by_prune = 0;
+		uint64_t cross_by_depth = 0;     // At Options::maximum_depth
+		uint64_t cross_by_split = 0;     // Left to the other jobs of JOB_NO
+		uint64_t cache_hits = 0;
+		uint64_t cache_misses = 0;
+		uint64_t cache_evictions = 0;
+		uint64_t choices = 0;
+		uint64_t forced_by_lookahead = 0;
+		uint64_t backjumps = 0;
+		uint64_t nogoods = 0;
+		uint64_t expansions = 0;
+		uint64_t rules[NUMBER_OF_RULES] = {};
+		// Nodes met at each depth, which JOB_NO splits the tableau by
+		std::vector<uint64_t> width;
+		Timings seconds;
+		Profile profile;
+
+		static const char* rule_name(Rule rule);
+
+		double frames_per_second() const
+		{
+			return seconds.search > 0 ? double(total_frames) / seconds.search
+			                          : 0;
+		}
+
+		// All of the above as a JSON object, on one line
+		std::string json() const;
+	};
+
+	// Knuth's estimate of the size of the tableau, from random descents of
+	// it, and how to split it between the jobs of JOB_NO
+	struct Estimate
+	{
+		double frames = 0;         // Nodes of the whole tree
+		std::vector<double> width; // At each depth, as in Stats::width
+		double seconds = 0;        // To explore the tree with a single job
+		uint32_t jobs = 1;
+		uint32_t split_depth = 1;  // The shallowest one with enough subtrees
+		                           // for the jobs to share them out evenly
+	};
+
+	struct Options
+	{
+		FrameID maximum_depth = FrameID::max();
+		// Number of worker threads sharing the search through work stealing
+		uint32_t threads = 1;
+		// Megabytes for the cache of crossed subtrees of each thread, zero
+		// disables it
+		uint32_t cache_size = 64;
+		Branching branching = Branching::FIXED;
+		// Seed of random initial scores for Branching::ACTIVITY, zero for none
+		uint64_t seed = 0;
+		// Before branching, tries each alternative with the alpha rules alone,
+		// and takes without a choice the only one not contradicting the frame
+		bool lookahead = false;
+		// Skips the choices of a state that did not lead to a contradiction
+		// found in it, and remembers the ones that did as a nogood
+		bool learning = false;
+		// Expands each state at once with a model of its rules found by a SAT
+		// solver, enumerating the models instead of branching on the beta
+		// formulas. Nothing is shared between threads this way.
+		bool sat = false;
+		// Raised by another thread to interrupt the search, which then ends
+		// with Result::UNDEFINED
+		const std::atomic<bool>* stop = nullptr;
+		// File the whole state of the search is saved to every
+		// checkpoint_interval frames (never if zero) and when it is stopped,
+		// to be continued later from there through resume. Only the searches
+		// of a single thread without sat can be saved.
+		std::string checkpoint;
+		uint64_t checkpoint_interval = 0;
+		std::string resume;
 	};
 
 	Solver() = delete;
-	~Solver() {}
+	~Solver();
 
 	Solver(const Solver&) = delete;
 	Solver(Solver&&) = delete;
@@ -77,6 +231,7 @@ public:
 	Solver& operator=(Solver&&) = delete;
 
 	Solver(FormulaPtr formula, FrameID maximum_depth = FrameID::max());
+	Solver(FormulaPtr formula, const Options& options);
 
 	FormulaPtr inline Formula() const;
 
@@ -92,7 +247,7 @@ public:
 
 	inline FrameID maximum_depth() const
 	{
-		return _maximum_depth;
+		return _options.maximum_depth;
 	}
 
 	inline const Stats& stats() const
@@ -100,36 +255,46 @@ public:
 		return _stats;
 	}
 
+	inline uint32_t threads() const
+	{
+		return _options.threads;
+	}
+
 	Result solution();
 	ModelPtr model();
 
+	// With the given number of descents, for the given number of jobs, or
+	// the number worth running for the time estimated if zero. Only the
+	// rules are estimated, without Options::sat.
+	Estimate estimate(uint32_t probes, uint32_t jobs = 0);
+
 private:
+	template <size_t Words, unsigned Features>
+	friend class Tableau;
+
 	FormulaPtr _formula;
 
-	FrameID _maximum_depth;
+	Options _options;
 
 	State _state;
 	Result _result;
 
 	struct
 	{
-		Bitset atom;
-		Bitset negation;
-		Bitset tomorrow;
-    Bitset yesterday;
-		Bitset always;
-		Bitset eventually;
-		Bitset conjunction;
-		Bitset disjunction;
-		Bitset until;
-    Bitset release;
-    Bitset since;
-    Bitset triggered;
-    Bitset past;
-    Bitset historically;
-
-		/* This is used to do computations avoiding allocations */
-		Bitset temporary;
+		DynamicBitset atom;
+		DynamicBitset negation;
+		DynamicBitset tomorrow;
+    DynamicBitset yesterday;
+		DynamicBitset always;
+		DynamicBitset eventually;
+		DynamicBitset conjunction;
+		DynamicBitset disjunction;
+		DynamicBitset until;
+    DynamicBitset release;
+    DynamicBitset since;
+    DynamicBitset triggered;
+    DynamicBitset past;
+    DynamicBitset historically;
 	} _bitset;
 
 	std::vector<FormulaID> _lhs;
@@ -141,44 +306,17 @@ private:
 
 	size_t _number_of_formulas;
 	FormulaID _start_index;
-	FrameID _loop_state;
 
 	std::vector<FormulaPtr> _subformulas;
-	Stack _stack;
 
-	Stats _stats;
+	// The search itself, on frames as wide as the closure needs
+	std::unique_ptr<TableauBase> _tableau;
 
-	bool _has_eventually;
-	bool _has_until;
-  bool _has_release;
+	Stats _stats;
 
 	void _initialize();
-	void _add_formula_for_position(const FormulaPtr& formula, FormulaID position, FormulaID lhs, FormulaID rhs);
-
-        inline bool _want_to_fork();
-	inline bool _check_contradiction_rule();
-	inline bool _apply_conjunction_rule();
-	inline bool _apply_always_rule();
-	inline bool _apply_disjunction_rule();
-	inline bool _apply_fork_disjunction_rule();
-	inline bool _apply_eventually_rule();
-	inline bool _apply_until_rule();
-  inline bool _apply_release_rule();
-
-	inline void _rollback_to_latest_choice();
-	inline void _update_eventualities_satisfaction();
-	inline void _update_history();
-
-	inline std::pair<bool, FrameID> _check_loop_rule() const;
-	inline bool _check_prune0_rule() const;
-	inline bool _check_prune_rule() const;
-	inline bool _check_my_prune() const;
-
 	void _print_stats() const;
-
-	void __dump_current_formulas() const;
-	void __dump_current_eventualities() const;
-	void __dump_eventualities(FrameID id) const;
+	void _add_formula_for_position(const FormulaPtr& formula, FormulaID position, FormulaID lhs, FormulaID rhs);
 };
 
 }
@@ -19,10 +19,11 @@ permission.
 
 #include <type_traits>
 #include <vector>
+#include <memory>
 #include <cstdint>
 #include <cassert>
-#include <limits>
-#include <tuple>
+#include <cstddef>
+#include <new>
 #include <utility>
 #include <iterator>
 
@@ -31,279 +32,208 @@ namespace LTL
 namespace detail
 {
 
-static constexpr size_t STARTING_SIZE = 1000;
-
+/*
+ * A stack stored in blocks of BlockN elements, which never move: pointers to
+ * the elements stay valid until they are popped.
+ * Popped elements are not destroyed, and the next push in their place
+ * assigns to them instead of constructing a new one (emplace() calls
+ * T::assign() with its arguments). With types like std::vector this reuses
+ * the memory they already own, so once the stack has been as deep as it gets,
+ * pushing and popping allocates nothing.
+ */
 template<typename T, size_t BlockN>
 class stack
 {
-	using indices_t = std::pair<uint64_t, uint64_t>;
 	template<typename Ptr> class iterator_t;
-	friend class iterator_t<T*>;
-	friend class iterator_t<const T*>;
 
 public:
+	using value_type = T;
 	using iterator = iterator_t<T*>;
 	using const_iterator = iterator_t<const T*>;
 	using reverse_iterator = std::reverse_iterator<iterator>;
 	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-	stack() : _blocks(STARTING_SIZE), _top(EMPTY_IDX) {}
-	~stack() = default;
-
-	stack(const stack&) = default;
-	stack(stack&&) = default;
+	stack() : _size(0), _constructed(0) {}
 
-	stack& operator=(const stack&) = default;
-	stack& operator=(stack&&) = default;
-
-	T& top()
+	~stack()
 	{
-		// Scott Meyers approves!
-		return const_cast<T&>(static_cast<const stack*>(this)->top());
+		for (size_t i = 0; i < _constructed; ++i)
+			(*this)[i].~T();
 	}
 
-	const T& top() const
-	{
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = indices();
+	stack(const stack&) = delete;
+	stack& operator=(const stack&) = delete;
 
-		assert(elem_idx < BlockN);
-		assert(block_idx < _blocks.size());
-
-		return (*_blocks[block_idx])[elem_idx];
-	}
-
-	bool empty() const
+	stack(stack&& other) : stack()
 	{
-		return _top == EMPTY_IDX;
+		swap(other);
 	}
 
-	size_t size() const
+	stack& operator=(stack&& other)
 	{
-		return static_cast<size_t>(_top + 1);
+		swap(other);
+		return *this;
 	}
 
-	void push(const T& value)
+	T& top()
 	{
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = increase_size();
-
-		_blocks[block_idx]->insert(elem_idx, value);
+		assert(!empty());
+		return (*this)[_size - 1];
 	}
 
-	void push(T&& value)
+	const T& top() const
 	{
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = increase_size();
-		
-		_blocks[block_idx]->insert(elem_idx, value);
+		assert(!empty());
+		return (*this)[_size - 1];
 	}
 
-	template<typename... Args>
-	void emplace(Args&&... args)
+	// Elements from the bottom of the stack
+	T& operator[](size_t pos)
 	{
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = increase_size();
-
-		_blocks[block_idx]->emplace(elem_idx, std::forward<Args>(args)...);
+		assert(pos < _constructed);
+		return *reinterpret_cast<T*>(&_blocks[pos / BlockN]->data[pos % BlockN]);
 	}
 
-	void pop()
+	const T& operator[](size_t pos) const
 	{
-		assert(_top != EMPTY_IDX);
-
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = indices();
-
-		_block[block_idx]->erase(elem_idx);
-		--_top;
+		assert(pos < _constructed);
+		return *reinterpret_cast<const T*>(
+			&_blocks[pos / BlockN]->data[pos % BlockN]);
 	}
 
-	void swap(stack& other)
+	bool empty() const
 	{
-		std::swap(_blocks, other._blocks);
-		std::swap(_top, other._top);
+		return _size == 0;
 	}
 
-	iterator begin()
+	size_t size() const
 	{
-		return iterator(*this, 0);
+		return _size;
 	}
 
-	iterator end()
+	T& push(const T& value)
 	{
-		return iterator(*this, _top + 1);
-	}
+		if (_size < _constructed)
+			return (*this)[_size++] = value;
 
-	const_iterator cbegin()
-	{
-		return const_iterator(*this, 0);
+		T* element = new (_reserve()) T(value);
+		_size = ++_constructed;
+		return *element;
 	}
 
-	const_iterator cend()
+	T& push(T&& value)
 	{
-		return const_iterator(*this, _top + 1);
+		if (_size < _constructed)
+			return (*this)[_size++] = std::move(value);
+
+		T* element = new (_reserve()) T(std::move(value));
+		_size = ++_constructed;
+		return *element;
 	}
 
-	reverse_iterator rbegin()
+	template<typename... Args>
+	T& emplace(Args&&... args)
 	{
-		return std::make_reverse_iterator(end());
+		if (_size < _constructed) {
+			T& slot = (*this)[_size++];
+			slot.assign(std::forward<Args>(args)...);
+			return slot;
+		}
+
+		T* element = new (_reserve()) T(std::forward<Args>(args)...);
+		_size = ++_constructed;
+		return *element;
 	}
 
-	reverse_iterator rend()
+	void pop()
 	{
-		return std::make_reverse_iterator(begin());
+		assert(!empty());
+		--_size;
 	}
 
-	const_reverse_iterator crbegin()
+	// Pops everything, keeping the elements around for the next pushes
+	void clear()
 	{
-		return std::make_reverse_iterator(cend());
+		_size = 0;
 	}
 
-	const_reverse_iterator crend()
+	void swap(stack& other)
 	{
-		return std::make_reverse_iterator(cbegin());
+		std::swap(_blocks, other._blocks);
+		std::swap(_size, other._size);
+		std::swap(_constructed, other._constructed);
 	}
 
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, _size); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, _size); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+private:
 	template<typename Ptr>
 	class iterator_t
 	{
 		friend class stack;
 
-		using pointed_type = typename std::remove_pointer<Ptr>::type;
+		using stack_ptr = typename std::conditional<
+			std::is_const<typename std::remove_pointer<Ptr>::type>::value,
+			const stack*, stack*>::type;
 
 	public:
-		iterator_t() = delete;
-		~iterator_t() = default;
-
-		// TODO: missing constructor, assignment operators, and full RandomAccessIterator interface
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Ptr;
+		using reference = typename std::remove_pointer<Ptr>::type&;
 
-		Ptr operator*()
-		{
-			uint64_t block_idx = 0;
-			uint64_t elem_idx = 0;
-			std::tie(block_idx, elem_idx) = _stack.indices(elem);
-
-			return &(_stack._blocks[block_idx][elem_idx]);
-		}
+		reference operator*() const { return (*_stack)[_pos]; }
+		pointer operator->() const { return &(*_stack)[_pos]; }
 
-		pointed_type& operator[](size_t n)
-		{
-			assert(elem + n < _stack._top);
+		iterator_t& operator++() { ++_pos; return *this; }
+		iterator_t& operator--() { --_pos; return *this; }
+		iterator_t operator++(int) { iterator_t it = *this; ++_pos; return it; }
+		iterator_t operator--(int) { iterator_t it = *this; --_pos; return it; }
 
-			uint64_t block_idx = 0;
-			uint64_t elem_idx = 0;
-			std::tie(block_idx, elem_idx) = _stack.indices(elem + n);
-
-			return _stack[block_idx][elem_idx];
-		}
+		bool operator==(const iterator_t& other) const { return _pos == other._pos; }
+		bool operator!=(const iterator_t& other) const { return _pos != other._pos; }
 
 	private:
-		iterator_t(stack& s, uint64_t elem) : _stack(s), _elem(elem) {}
+		iterator_t(stack_ptr s, size_t pos) : _stack(s), _pos(pos) {}
 
-		stack& _stack;
-		uint64_t elem;
+		stack_ptr _stack;
+		size_t _pos;
 	};
 
-private:
-	class Block
+	struct Block
 	{
-	public:
-		Block() = default;
-		~Block() = default;
-
-		Block(const Block&) = delete;
-		Block(Block&&) = delete;
-
-		Block& operator=(const Block&) = delete;
-		Block& operator=(Block&&) = delete;
-
-		void insert(size_t pos, const T& elem)
-		{
-			assert(pos < BlockN);
-			new(_data + pos) T(elem);
-		}
-
-		void insert(size_t pos, T&& elem)
-		{
-			assert(pos < BlockN);
-			new(_data + pos) T(elem);
-		}
-
-		template<typename ...Args>
-		void emplace(size_t pos, Args&&... args)
-		{
-			assert(pos < BlockN);
-			new(_data + pos) T(std::forward<Args>(args)...);
-		}
-
-		void erase(size_t pos)
-		{
-			assert(pos < BlockN);
-			reinterpret_cast<const T*>(_data + pos)->~T();
-		}
-
-		const T& operator[](size_t pos) const
-		{
-			assert(pos < BlockN);
-			return *reinterpret_cast<const T*>(_data + pos);
-		}
-
-		T& operator[](size_t pos)
-		{
-			assert(pos < BlockN);
-			return *reinterpret_cast<T*>(_data + pos);
-		}
-
-	private:
-		typename std::aligned_storage<sizeof(T), alignof(T)>::type _data[BlockN];
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type data[BlockN];
 	};
-	
-	std::vector<Block*> _blocks;
-	uint64_t _top;
-	
-	indices_t indices() const
-	{
-		return indices(_top);
-	}
 
-	indices_t indices(uint64_t elem) const
-	{
-		return { elem / BlockN, elem % BlockN };
-	}
+	std::vector<std::unique_ptr<Block>> _blocks;
+	size_t _size;
+	size_t _constructed;  // Elements ever pushed, the ones past _size are popped
 
-	indices_t increase_size()
+	// Raw memory for a new element on top of every element ever pushed
+	void* _reserve()
 	{
-		++_top;
-		assert(_top != std::numeric_limits<uint64_t>::max());
-
-		uint64_t block_idx = 0;
-		uint64_t elem_idx = 0;
-		std::tie(block_idx, elem_idx) = indices();
+		assert(_size == _constructed);
 
-		if (block_idx == _blocks.size())
-		{
-			_blocks.push_back(new Block());
-			assert(_block_idx == _blocks.size() + 1);
-		}
-
-		assert(elem_idx < BlockN);
-		assert(block_idx < _blocks.size());
+		if (_constructed == _blocks.size() * BlockN)
+			_blocks.emplace_back(new Block());
 
-		return { block_idx, elem_idx };
+		return &_blocks[_constructed / BlockN]->data[_constructed % BlockN];
 	}
-
-	static constexpr uint64_t EMPTY_IDX = std::numeric_limits<uint64_t>::max();
 };
 
-template<typename T, uint64_t BlockN>
-void swap(stack<T, BlockN>& lhs,
-		  stack<T, BlockN>& rhs)
+template<typename T, size_t BlockN>
+void swap(stack<T, BlockN>& lhs, stack<T, BlockN>& rhs)
 {
 	lhs.swap(rhs);
 }
@@ -0,0 +1,126 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "bitset.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace LTL {
+namespace detail {
+
+/*
+ * The sets of tomorrow formulas of STEP frames whose successor turned out to
+ * be closed. The table is direct-mapped: a set hashing to a taken slot
+ * replaces the previous one. It starts small and doubles while it stays
+ * within the given number of bytes.
+ */
+template <size_t Words>
+class CrossedCache {
+public:
+  using Bitset = detail::Bitset<Words>;
+
+  explicit CrossedCache(size_t bytes = 0) : _bytes(bytes), _size(0) {}
+
+  bool enabled() const { return _bytes > 0; }
+
+  bool contains(const Bitset &key) const
+  {
+    if (_slots.empty())
+      return false;
+
+    const uint64_t hash = _hash(key);
+    const Slot &slot = _slots[hash & (_slots.size() - 1)];
+    return slot.hash == hash && slot.key == key;
+  }
+
+  // Returns true if another set had to be evicted to make room
+  bool insert(const Bitset &key)
+  {
+    if (!enabled())
+      return false;
+
+    if (_size >= _slots.size() / 2)
+      _grow(key.num_words());
+
+    if (_slots.empty())
+      return false;
+
+    const uint64_t hash = _hash(key);
+    Slot &slot = _slots[hash & (_slots.size() - 1)];
+    bool evicted = slot.hash != 0 && !(slot.hash == hash && slot.key == key);
+
+    if (slot.hash == 0)
+      ++_size;
+    slot.hash = hash;
+    slot.key = key;
+
+    return evicted;
+  }
+
+private:
+  static constexpr size_t INITIAL_SLOTS = 1024;
+
+  struct Slot {
+    uint64_t hash = 0;  // Zero for the empty slots
+    Bitset key;
+  };
+
+  size_t _bytes;
+  size_t _size;
+  std::vector<Slot> _slots;
+
+  static uint64_t _hash(const Bitset &key)
+  {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < key.num_words(); ++i)
+      hash = (hash ^ key.words()[i]) * 0x9e3779b97f4a7c15;
+
+    hash ^= hash >> 32;
+    return hash | 1;
+  }
+
+  // Doubles the table, if it still fits in the budget afterwards
+  void _grow(size_t words)
+  {
+    size_t slots = _slots.empty() ? INITIAL_SLOTS : _slots.size() * 2;
+    if (slots * (sizeof(Slot) + (Words ? 0 : words * sizeof(uint64_t))) >
+        _bytes)
+      return;
+
+    std::vector<Slot> old(slots);
+    std::swap(old, _slots);
+
+    _size = 0;
+    for (const Slot &slot : old) {
+      if (slot.hash == 0)
+        continue;
+
+      Slot &target = _slots[slot.hash & (_slots.size() - 1)];
+      if (target.hash == 0)
+        ++_size;
+      target = slot;
+    }
+  }
+};
+
+template <size_t Words>
+constexpr size_t CrossedCache<Words>::INITIAL_SLOTS;
+}
+}
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#include "portfolio.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace LTL {
+namespace detail {
+
+Portfolio::Portfolio(FormulaPtr formula,
+                     const std::vector<Solver::Options> &configurations)
+  : _stop(false), _winner(nullptr)
+{
+  for (Solver::Options options : configurations) {
+    options.stop = &_stop;
+    _solvers.emplace_back(new Solver(formula, options));
+  }
+}
+
+std::vector<Solver::Options>
+Portfolio::configurations(const Solver::Options &base, size_t count)
+{
+  static const Solver::Branching branchings[] = {
+    Solver::Branching::FIXED, Solver::Branching::EVENTUALITIES,
+    Solver::Branching::ACTIVITY, Solver::Branching::FEWEST_NEW};
+
+  std::vector<Solver::Options> result;
+  for (size_t i = 0; i < count; ++i) {
+    // The configurations racing are not saved, nor resumed
+    Solver::Options options = base;
+    options.checkpoint.clear();
+    options.resume.clear();
+    // The seed only matters to the activity policy, which without one
+    // starts out choosing like the fixed one
+    if (i < 4)
+      options.branching = branchings[i];
+    else
+      options.branching = Solver::Branching::ACTIVITY;
+    if (options.branching == Solver::Branching::ACTIVITY)
+      options.seed = i < 4 ? 1 : i - 2;
+    result.push_back(options);
+  }
+
+  return result;
+}
+
+Solver::Result Portfolio::solution()
+{
+  if (_winner)
+    return _winner->satisfiability();
+
+  std::mutex mutex;
+  std::vector<std::thread> threads;
+  for (auto &solver : _solvers) {
+    Solver *s = solver.get();
+    threads.emplace_back([this, s, &mutex] {
+      Solver::Result result = s->solution();
+
+      // Nothing is proved by a search stopped early, or by a tableau cut at
+      // a maximum depth finding no model
+      if (result == Solver::Result::UNDEFINED ||
+          (result == Solver::Result::UNSATISFIABLE &&
+           s->maximum_depth() != FrameID::max()))
+        return;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!_winner) {
+        _winner = s;
+        _stop = true;
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  // Every search ran up to its maximum depth: that is the best answer we have
+  for (size_t i = 0; i < _solvers.size() && !_winner; ++i)
+    if (_solvers[i]->satisfiability() == Solver::Result::UNSATISFIABLE)
+      _winner = _solvers[i].get();
+
+  return _winner ? _winner->satisfiability() : Solver::Result::UNDEFINED;
+}
+
+size_t Portfolio::winner_index() const
+{
+  auto it = std::find_if(
+    _solvers.begin(), _solvers.end(),
+    [this](const std::unique_ptr<Solver> &s) { return s.get() == _winner; });
+
+  return size_t(it - _solvers.begin());
+}
+}
+}
@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "solver.hpp"
+
+#include <cstdint>
+
+/*
+ * Timing of the phases of the search into Solver::Profile, for the builds
+ * with LEVIATHAN_PROFILE. In the others the macros below leave the code they
+ * are given alone, and nothing is ever read or recorded.
+ *
+ *   PROFILE_SCOPE(PHASE);                 times the rest of the scope
+ *   x = PROFILED(PHASE, expression);      times the expression
+ *
+ * Both record into _stats.profile of the Tableau they are used in.
+ */
+#ifdef LEVIATHAN_PROFILE
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace LTL {
+namespace detail {
+
+// Not serializing: a run may overlap a few instructions of its neighbours,
+// which the buckets of powers of two hardly see
+inline uint64_t read_cycles()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  // Nanoseconds, where there is no timestamp counter to read
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+#endif
+}
+
+inline void record(Solver::Profile::Histogram &histogram, uint64_t cycles)
+{
+  size_t bucket = 0;
+  if (cycles > 1) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, cycles);
+    bucket = index;
+#else
+    bucket = 63 - static_cast<size_t>(__builtin_clzll(cycles));
+#endif
+  }
+
+  ++histogram.runs;
+  histogram.cycles += cycles;
+  ++histogram.buckets[bucket];
+}
+
+// Records the cycles from its construction to its destruction
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Solver::Profile::Histogram &histogram)
+    : _histogram(histogram), _start(read_cycles())
+  {
+  }
+
+  ~PhaseTimer() { record(_histogram, read_cycles() - _start); }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+  Solver::Profile::Histogram &_histogram;
+  uint64_t _start;
+};
+}
+}
+
+#define PROFILE_SCOPE(phase)                                                 \
+  ::LTL::detail::PhaseTimer phase_timer(                                     \
+    _stats.profile.phases[Solver::Profile::phase])
+
+// The temporary lives until the end of the full expression
+#define PROFILED(phase, expression)                                          \
+  (::LTL::detail::PhaseTimer(_stats.profile.phases[Solver::Profile::phase]), \
+   (expression))
+
+#else
+
+#define PROFILE_SCOPE(phase) static_cast<void>(0)
+#define PROFILED(phase, expression) (expression)
+
+#endif
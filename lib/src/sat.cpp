@@ -0,0 +1,355 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#include "sat.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace LTL {
+namespace detail {
+
+namespace {
+
+uint32_t variable(SatSolver::Literal literal) { return literal / 2; }
+}
+
+constexpr uint32_t SatSolver::NONE;
+
+void SatSolver::clear()
+{
+  for (size_t l = 0; l < 2 * variables(); ++l)
+    _watches[l].clear();
+
+  _unsatisfiable = false;
+  _literals.clear();
+  _clauses.clear();
+  _value.clear();
+  _level.clear();
+  _reason.clear();
+  _phase.clear();
+  _model.clear();
+  _trail.clear();
+  _trail_limits.clear();
+  _qhead = 0;
+  _priority.clear();
+  _heap.clear();
+  _heap_index.clear();
+  _seen.clear();
+}
+
+uint32_t SatSolver::new_variable(bool phase, uint32_t priority)
+{
+  const uint32_t var = uint32_t(variables());
+  if (_watches.size() < 2 * var + 2)
+    _watches.resize(2 * var + 2);
+
+  _value.push_back(UNASSIGNED);
+  _value.push_back(UNASSIGNED);
+  _level.push_back(0);
+  _reason.push_back(NONE);
+  _phase.push_back(phase);
+  _model.push_back(false);
+  _priority.push_back(priority);
+  _heap_index.push_back(NONE);
+  _seen.push_back(false);
+  _heap_insert(var);
+
+  return var;
+}
+
+bool SatSolver::add_clause(const std::vector<Literal> &clause)
+{
+  _added = clause;
+  return _add_clause();
+}
+
+bool SatSolver::_add_clause()
+{
+  _cancel_until(0);
+  if (_unsatisfiable)
+    return false;
+
+  // Satisfied clauses are dropped, and so are the literals already false
+  std::sort(_added.begin(), _added.end());
+  size_t size = 0;
+  for (size_t i = 0; i < _added.size(); ++i) {
+    const Literal literal = _added[i];
+    assert(variable(literal) < variables());
+    if (_value[literal] == SATISFIED ||
+        (size > 0 && _added[size - 1] == (literal ^ 1)))
+      return true;
+    if (_value[literal] == UNASSIGNED &&
+        (size == 0 || _added[size - 1] != literal))
+      _added[size++] = literal;
+  }
+  _added.resize(size);
+
+  if (_added.empty()) {
+    _unsatisfiable = true;
+    return false;
+  }
+
+  if (_added.size() == 1) {
+    _assign(_added[0], NONE);
+    _unsatisfiable = _propagate() != NONE;
+    return !_unsatisfiable;
+  }
+
+  _attach(_added);
+  return true;
+}
+
+uint32_t SatSolver::_attach(const std::vector<Literal> &clause)
+{
+  assert(clause.size() >= 2);
+  const uint32_t index = uint32_t(_clauses.size());
+  _clauses.push_back({uint32_t(_literals.size()), uint32_t(clause.size())});
+  _literals.insert(_literals.end(), clause.begin(), clause.end());
+  _watches[clause[0]].push_back(index);
+  _watches[clause[1]].push_back(index);
+
+  return index;
+}
+
+void SatSolver::_assign(Literal literal, uint32_t reason)
+{
+  assert(_value[literal] == UNASSIGNED);
+  _value[literal] = SATISFIED;
+  _value[literal ^ 1] = FALSIFIED;
+  _level[variable(literal)] = uint32_t(_decision_level());
+  _reason[variable(literal)] = reason;
+  _trail.push_back(literal);
+}
+
+// Returns the clause found falsified, if any. The literal a clause implies is
+// always its first one.
+uint32_t SatSolver::_propagate()
+{
+  uint32_t conflict = NONE;
+
+  while (_qhead < _trail.size() && conflict == NONE) {
+    const Literal falsified = _trail[_qhead++] ^ 1;
+    std::vector<uint32_t> &watches = _watches[falsified];
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < watches.size()) {
+      const uint32_t index = watches[i++];
+      Literal *clause = &_literals[_clauses[index].begin];
+      const uint32_t size = _clauses[index].size;
+
+      if (clause[0] == falsified)
+        std::swap(clause[0], clause[1]);
+
+      if (_value[clause[0]] == SATISFIED) {
+        watches[j++] = index;
+        continue;
+      }
+
+      bool moved = false;
+      for (uint32_t k = 2; k < size && !moved; ++k) {
+        if (_value[clause[k]] != FALSIFIED) {
+          std::swap(clause[1], clause[k]);
+          _watches[clause[1]].push_back(index);
+          moved = true;
+        }
+      }
+      if (moved)
+        continue;
+
+      watches[j++] = index;
+      if (_value[clause[0]] == FALSIFIED) {
+        conflict = index;
+        while (i < watches.size())
+          watches[j++] = watches[i++];
+      }
+      else
+        _assign(clause[0], index);
+    }
+    watches.resize(j);
+  }
+
+  return conflict;
+}
+
+// Learns the first UIP clause of the conflict in _learnt, the asserting
+// literal first and one of the highest level after it, and returns the level
+// to go back to
+size_t SatSolver::_analyze(uint32_t conflict)
+{
+  _learnt.clear();
+  _learnt.push_back(0);
+
+  size_t pending = 0;
+  size_t index = _trail.size();
+  Literal implied = NONE;
+
+  do {
+    assert(conflict != NONE);
+    const Literal *clause = &_literals[_clauses[conflict].begin];
+    const uint32_t size = _clauses[conflict].size;
+
+    for (uint32_t k = implied == NONE ? 0 : 1; k < size; ++k) {
+      const uint32_t var = variable(clause[k]);
+      if (_seen[var] || _level[var] == 0)
+        continue;
+
+      _seen[var] = true;
+      if (_level[var] >= _decision_level())
+        ++pending;
+      else
+        _learnt.push_back(clause[k]);
+    }
+
+    while (!_seen[variable(_trail[--index])]) {
+    }
+    implied = _trail[index];
+    conflict = _reason[variable(implied)];
+    _seen[variable(implied)] = false;
+    --pending;
+  } while (pending > 0);
+
+  _learnt[0] = implied ^ 1;
+
+  size_t level = 0;
+  for (size_t k = 1; k < _learnt.size(); ++k) {
+    _seen[variable(_learnt[k])] = false;
+    if (_level[variable(_learnt[k])] > level) {
+      level = _level[variable(_learnt[k])];
+      std::swap(_learnt[1], _learnt[k]);
+    }
+  }
+
+  return level;
+}
+
+void SatSolver::_cancel_until(size_t level)
+{
+  if (_decision_level() <= level)
+    return;
+
+  for (size_t i = _trail.size(); i > _trail_limits[level]; --i) {
+    const Literal literal = _trail[i - 1];
+    const uint32_t var = variable(literal);
+    _value[literal] = UNASSIGNED;
+    _value[literal ^ 1] = UNASSIGNED;
+    _heap_insert(var);
+  }
+
+  _trail.resize(_trail_limits[level]);
+  _trail_limits.resize(level);
+  _qhead = _trail.size();
+}
+
+bool SatSolver::solve()
+{
+  if (_unsatisfiable)
+    return false;
+
+  _cancel_until(0);
+  for (;;) {
+    const uint32_t conflict = _propagate();
+    if (conflict != NONE) {
+      if (_decision_level() == 0) {
+        _unsatisfiable = true;
+        return false;
+      }
+
+      _cancel_until(_analyze(conflict));
+      if (_learnt.size() == 1)
+        _assign(_learnt[0], NONE);
+      else
+        _assign(_learnt[0], _attach(_learnt));
+      continue;
+    }
+
+    uint32_t next = NONE;
+    while (next == NONE && !_heap.empty()) {
+      const uint32_t var = _heap_pop();
+      if (_value[positive(var)] == UNASSIGNED)
+        next = var;
+    }
+
+    if (next == NONE) {
+      for (uint32_t var = 0; var < variables(); ++var)
+        _model[var] = _value[positive(var)] == SATISFIED;
+      return true;
+    }
+
+    _trail_limits.push_back(_trail.size());
+    _assign(_phase[next] ? positive(next) : negative(next), NONE);
+  }
+}
+
+void SatSolver::_heap_insert(uint32_t var)
+{
+  if (_heap_index[var] != NONE)
+    return;
+
+  _heap_index[var] = uint32_t(_heap.size());
+  _heap.push_back(var);
+  _heap_up(_heap.size() - 1);
+}
+
+void SatSolver::_heap_up(size_t i)
+{
+  const uint32_t var = _heap[i];
+  while (i > 0 && _before(var, _heap[(i - 1) / 2])) {
+    _heap[i] = _heap[(i - 1) / 2];
+    _heap_index[_heap[i]] = uint32_t(i);
+    i = (i - 1) / 2;
+  }
+  _heap[i] = var;
+  _heap_index[var] = uint32_t(i);
+}
+
+void SatSolver::_heap_down(size_t i)
+{
+  const uint32_t var = _heap[i];
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= _heap.size())
+      break;
+    if (child + 1 < _heap.size() && _before(_heap[child + 1], _heap[child]))
+      ++child;
+    if (!_before(_heap[child], var))
+      break;
+
+    _heap[i] = _heap[child];
+    _heap_index[_heap[i]] = uint32_t(i);
+    i = child;
+  }
+  _heap[i] = var;
+  _heap_index[var] = uint32_t(i);
+}
+
+uint32_t SatSolver::_heap_pop()
+{
+  const uint32_t top = _heap.front();
+  _heap_index[top] = NONE;
+
+  _heap.front() = _heap.back();
+  _heap.pop_back();
+  if (!_heap.empty()) {
+    _heap_index[_heap.front()] = 0;
+    _heap_down(0);
+  }
+
+  return top;
+}
+}
+}
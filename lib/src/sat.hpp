@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+namespace LTL {
+namespace detail {
+
+/*
+ * A small incremental CDCL SAT solver: two watched literals and first UIP
+ * clause learning. Decisions follow a fixed order of the variables, each one
+ * taking a fixed value first, so that the model found is the greatest in that
+ * order. Clauses can be added between calls to solve(), which is how the
+ * models already found are blocked to enumerate the others: from the greatest
+ * down, as a depth first search taking the same decisions would.
+ * Tableau uses one per state with Options::sat, see Tableau::_expand_state().
+ */
+class SatSolver {
+public:
+  // The literals of variable v are 2v and its negation 2v + 1
+  using Literal = uint32_t;
+
+  static Literal positive(uint32_t var) { return 2 * var; }
+  static Literal negative(uint32_t var) { return 2 * var + 1; }
+
+  SatSolver() : _unsatisfiable(false), _qhead(0) {}
+
+  // Forgets every variable and clause, keeping the memory for the next ones
+  void clear();
+
+  // A new variable, decided with the given value before the variables of
+  // lower priority, and of equal priority created after it
+  uint32_t new_variable(bool phase = false, uint32_t priority = 0);
+  size_t variables() const { return _level.size(); }
+
+  // False if the clauses are known to be unsatisfiable already
+  bool add_clause(const std::vector<Literal> &clause);
+  bool add_clause(std::initializer_list<Literal> clause)
+  {
+    _added.assign(clause.begin(), clause.end());
+    return _add_clause();
+  }
+
+  bool solve();
+
+  // The value of the variable in the model found by the last solve()
+  bool value(uint32_t var) const { return _model[var]; }
+
+private:
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+  enum : int8_t { FALSIFIED = -1, UNASSIGNED = 0, SATISFIED = 1 };
+
+  struct Clause {
+    uint32_t begin;  // In _literals
+    uint32_t size;
+  };
+
+  bool _unsatisfiable;
+
+  std::vector<Literal> _literals;
+  std::vector<Clause> _clauses;
+  std::vector<std::vector<uint32_t>> _watches;  // The clauses watching each
+                                                // literal, first two in them
+
+  std::vector<int8_t> _value;  // By literal
+  std::vector<uint32_t> _level;
+  std::vector<uint32_t> _reason;  // The clause that implied each variable
+  std::vector<bool> _phase;
+  std::vector<uint32_t> _priority;
+  std::vector<bool> _model;
+
+  std::vector<Literal> _trail;
+  std::vector<size_t> _trail_limits;  // Where each decision level begins
+  size_t _qhead;
+
+  // Heap of the unassigned variables, the next one to decide on top
+  std::vector<uint32_t> _heap;
+  std::vector<uint32_t> _heap_index;
+
+  // Scratch space
+  std::vector<Literal> _added;
+  std::vector<Literal> _learnt;
+  std::vector<bool> _seen;
+
+  bool _add_clause();
+  uint32_t _attach(const std::vector<Literal> &clause);
+
+  size_t _decision_level() const { return _trail_limits.size(); }
+  void _assign(Literal literal, uint32_t reason);
+  uint32_t _propagate();
+  size_t _analyze(uint32_t conflict);
+  void _cancel_until(size_t level);
+
+  bool _before(uint32_t var, uint32_t other) const
+  {
+    return _priority[var] > _priority[other] ||
+           (_priority[var] == _priority[other] && var < other);
+  }
+  void _heap_insert(uint32_t var);
+  void _heap_up(size_t i);
+  void _heap_down(size_t i);
+  uint32_t _heap_pop();
+};
+}
+}
@@ -3,9 +3,22 @@
 #include "ast/generator.hpp"
 #include "format.hpp"
 #include "pretty_printer.hpp"
-#include "utility.hpp"
+#include "profile.hpp"
+#include "tableau.hpp"
+#include "work_pool.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #ifdef _MSC_VER
 #define __builtin_expect(cond, value) (cond)
@@ -17,34 +30,162 @@ namespace detail {
 
 namespace colors = format::colors;
 
+// How many iterations of the main loop a search does before looking at the
+// pool of its workers and at Options::stop. Must be a power of two.
+static constexpr uint32_t POLL_INTERVAL = 256;
+
+// Same for the cross-process pool, which costs a directory scan. Must be a
+// multiple of POLL_INTERVAL.
+static constexpr uint32_t JOB_POOL_POLL_INTERVAL = 16384;
+
+// The descents estimate() makes for JOB_NO=i/n@auto
+static constexpr uint32_t AUTO_SPLIT_PROBES = 1000;
+
+// Where the descents of estimate() stop, as if at a leaf
+static constexpr size_t MAX_PROBE_DEPTH = 1024;
+
+// The subtrees at the split depth for each job of JOB_NO, so that the
+// assignment of to_job() evens out their sizes
+static constexpr double SUBTREES_PER_JOB = 16;
+
+// The work worth starting one more job for, and the most jobs estimate()
+// suggests
+static constexpr double MIN_JOB_SECONDS = 10;
+static constexpr uint32_t MAX_JOBS = 1024;
+
+// Bumped whenever the layout of the checkpoints changes
+static constexpr uint64_t CHECKPOINT_MAGIC = 0x4c5643484b500004;
+
+// The statistics saved in the checkpoints
+static uint64_t Solver::Stats::*const SAVED_STATS[] = {
+  &Solver::Stats::maximum_frames,         &Solver::Stats::total_frames,
+  &Solver::Stats::maximum_model_size,     &Solver::Stats::current_model_size,
+  &Solver::Stats::cross_by_contradiction, &Solver::Stats::cross_by_prune,
+  &Solver::Stats::cross_by_depth,         &Solver::Stats::cross_by_split,
+  &Solver::Stats::cache_hits,             &Solver::Stats::cache_misses,
+  &Solver::Stats::cache_evictions,        &Solver::Stats::choices,
+  &Solver::Stats::forced_by_lookahead,    &Solver::Stats::backjumps,
+  &Solver::Stats::nogoods,                &Solver::Stats::expansions};
+
+static void write_double(std::ostream &os, double value)
+{
+  uint64_t word;
+  std::memcpy(&word, &value, sizeof(word));
+  write_word(os, word);
+}
+
+static double read_double(std::istream &is)
+{
+  const uint64_t word = read_word(is);
+  double value;
+  std::memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+// FNV-1a, to tell the checkpoints of different searches apart, and the
+// damaged ones
+static constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+
+static uint64_t fnv1a(uint64_t hash, const std::string &bytes)
+{
+  for (unsigned char c : bytes)
+    hash = (hash ^ c) * 0x100000001b3;
+  return hash;
+}
+
+// Deterministic, so that every worker and every job hashes the same way
+static uint64_t splitmix64(uint64_t &state)
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+// Seconds from the given time to now, which it is moved to
+static double lap(std::chrono::steady_clock::time_point &since)
+{
+  const auto now = std::chrono::steady_clock::now();
+  const std::chrono::duration<double> elapsed = now - since;
+  since = now;
+  return elapsed.count();
+}
+
+// Adds the time it lives to the given seconds, whichever way its scope ends
+class Stopwatch {
+public:
+  explicit Stopwatch(double &seconds)
+    : _seconds(seconds), _start(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~Stopwatch() { _seconds += lap(_start); }
+
+private:
+  double &_seconds;
+  std::chrono::steady_clock::time_point _start;
+};
+
 Solver::Solver(FormulaPtr formula, FrameID maximum_depth)
+  : Solver(formula, Options())
+{
+  _options.maximum_depth = maximum_depth;
+}
+
+Solver::Solver(FormulaPtr formula, const Options &options)
   : _formula(formula),
-    _maximum_depth(maximum_depth),
+    _options(options),
     _state(State::UNINITIALIZED),
     _result(Result::UNDEFINED),
     _start_index(0),
-    _loop_state(0),
-    _stats(),
-    _has_eventually(true),
-    _has_until(true),
-    _has_release(true)
+    _stats()
 {
+  if (_options.threads == 0)
+    _options.threads = 1;
+
+  if ((!_options.checkpoint.empty() || !_options.resume.empty()) &&
+      (_options.threads > 1 || _options.sat)) {
+    format::error("Checkpoints are ignored with {}",
+                  _options.sat ? "the SAT expansion" : "multiple threads");
+    _options.checkpoint.clear();
+    _options.resume.clear();
+  }
+
   _initialize();
 }
 
+Solver::~Solver() {}
+
 // Forward declaration
 static bool formula_ordering_func(const FormulaPtr& a, const FormulaPtr& b);
 
+// The tableau on the narrowest frames the closure fits in
+template <unsigned Features>
+static TableauBase *make_tableau(const Solver &solver, size_t words)
+{
+  if (words <= 1)
+    return new Tableau<1, Features>(solver);
+  if (words <= 2)
+    return new Tableau<2, Features>(solver);
+  if (words <= 4)
+    return new Tableau<4, Features>(solver);
+  if (words <= 8)
+    return new Tableau<8, Features>(solver);
+  return new Tableau<0, Features>(solver);
+}
+
 // TODO: Break this down
 void Solver::_initialize()
 {
   format::debug("Initializing solver...");
   _atom_set.clear();
+  auto start = std::chrono::steady_clock::now();
 
   /* Simplify the formula and put it in normal form */
   format::debug("Simplifing formula...");
   Simplifier simplifier;
   _formula = simplifier.simplify(_formula);
+  _stats.seconds.simplification = lap(start);
 
   /* Generate every subformulas */
   format::debug("Generating subformulas...");
@@ -55,17 +196,17 @@ void Solver::_initialize()
   /* The simplification might just have produces a True or False */
   if (_subformulas.size() == 1) {
     if (isa<True>(_subformulas[0])) {
-      std::cout << "^0:" << clock() << std::endl;
-      std::cerr << "Issat!"  << std::endl; 
       _result = Result::SATISFIABLE;
       _state = State::DONE;
+      _stats.seconds.closure = lap(start);
+      _print_stats();
       return;
     }
     else if (isa<False>(_subformulas[0])) {
       _result = Result::UNSATISFIABLE;
-      std::cout << "^0:" << clock() << std::endl;
-      std::cerr << "Unsat!"  << std::endl; 
       _state = State::DONE;
+      _stats.seconds.closure = lap(start);
+      _print_stats();
       return;
     }
   }
@@ -95,7 +236,8 @@ void Solver::_initialize()
   _bitset.release.resize(_number_of_formulas);
   _bitset.since.resize(_number_of_formulas);
   _bitset.triggered.resize(_number_of_formulas);
-  _bitset.temporary.resize(_number_of_formulas);
+  _bitset.past.resize(_number_of_formulas);
+  _bitset.historically.resize(_number_of_formulas);
 
   _lhs = std::vector<FormulaID>(_number_of_formulas, FormulaID::max());
   _rhs = std::vector<FormulaID>(_number_of_formulas, FormulaID::max());
@@ -184,14 +326,18 @@ void Solver::_initialize()
   }
 
   format::debug("Found {} eventualities", eventualities.size());
-
-  /* We are now ready to start the computation */
-  _has_eventually = _bitset.eventually.any();
-  _has_until = _bitset.until.any();
-  _has_release = _bitset.release.any();
-
-  _stack.push(Frame(FrameID(0), _start_index, _number_of_formulas,
-                    _bw_eventualities_lut.size()));
+  _stats.seconds.closure = lap(start);
+
+  /* We are now ready to start the computation, on the narrowest frames the
+     closure fits in. Safety formulas need no eventuality bookkeeping. */
+  const size_t words = (_number_of_formulas + 63) / 64;
+  if (_bw_eventualities_lut.empty())
+    _tableau.reset(make_tableau<0>(*this, words));
+  else
+    _tableau.reset(make_tableau<ALL_FEATURES>(*this, words));
+  _stats.seconds.tableau = lap(start);
+
+  format::debug("Using {} words per frame", words);
   _state = State::INITIALIZED;
 
   format::debug("Solver initialized!");
@@ -294,19 +440,350 @@ void Solver::_add_formula_for_position(const FormulaPtr &formula, FormulaID posi
   }
 }
 
-bool Solver::_check_contradiction_rule()
+template <size_t Words, unsigned Features>
+Tableau<Words, Features>::Tableau(const Solver &solver)
+  : _options(solver._options),
+    _state(State::INITIALIZED),
+    _result(Result::UNDEFINED),
+    _lhs(solver._lhs),
+    _rhs(solver._rhs),
+    _atom_set(solver._atom_set),
+    _fw_eventualities_lut(solver._fw_eventualities_lut),
+    _bw_eventualities_lut(solver._bw_eventualities_lut),
+    _number_of_formulas(solver._number_of_formulas),
+    _start_index(solver._start_index),
+    _loop_state(0),
+    _subformulas(solver._subformulas),
+    _reasons(solver._number_of_formulas, Reason{0, 0}),
+    _conflict(0),
+    _watches(solver._number_of_formulas),
+    _complement(solver._number_of_formulas, FormulaID::max()),
+    _clash(false),
+    _cache(size_t(solver._options.cache_size) << 20),
+    _tainted(0),
+    _cache_depth(0),
+    _activity(solver._number_of_formulas, 0.0),
+    _activity_increment(1.0),
+    _stats(),
+    _pool(nullptr),
+    _poll_counter(0),
+    _next_checkpoint(0)
+{
+  _bitset.negation = Bitset(solver._bitset.negation);
+  _bitset.tomorrow = Bitset(solver._bitset.tomorrow);
+  _bitset.always = Bitset(solver._bitset.always);
+  _bitset.eventually = Bitset(solver._bitset.eventually);
+  _bitset.conjunction = Bitset(solver._bitset.conjunction);
+  _bitset.disjunction = Bitset(solver._bitset.disjunction);
+  _bitset.until = Bitset(solver._bitset.until);
+  _bitset.release = Bitset(solver._bitset.release);
+  _bitset.alpha = _bitset.conjunction;
+  _bitset.alpha |= _bitset.always;
+  _bitset.beta = _bitset.disjunction;
+  _bitset.beta |= _bitset.eventually;
+  _bitset.beta |= _bitset.until;
+  _bitset.beta |= _bitset.release;
+  _bitset.goal = Bitset(_number_of_formulas);
+  for (FormulaID goal : _bw_eventualities_lut)
+    _bitset.goal.set(goal);
+  _bitset.temporary = Bitset(_number_of_formulas);
+  _bitset.lookahead = Bitset(_number_of_formulas);
+  _bitset.watched = Bitset(_number_of_formulas);
+  _build_shifts();
+
+  _bitset.beta_free = Bitset(_number_of_formulas);
+  _alpha_closure.resize(_number_of_formulas);
+  std::vector<bool> visited(_number_of_formulas, false);
+  for (size_t i = 0; i < _number_of_formulas; ++i)
+    if (_bitset.alpha[i])
+      _build_alpha_closure(i, visited);
+
+  // The closure puts every negation right after its argument, which
+  // _has_clash() relies upon
+  for (size_t i = 0; i < _number_of_formulas; ++i) {
+    if (_bitset.negation[i]) {
+      assert(_lhs[i] == FormulaID(i - 1));
+      _complement[i] = _lhs[i];
+      _complement[_lhs[i]] = FormulaID(i);
+    }
+  }
+
+  uint64_t seed = 0;
+  _zobrist.resize(_number_of_formulas);
+  for (auto &key : _zobrist)
+    key = splitmix64(seed);
+
+  if (_options.seed) {
+    uint64_t state = _options.seed;
+    for (double &activity : _activity)
+      activity = double(splitmix64(state) >> 11) / double(uint64_t(1) << 53);
+  }
+
+  _stack.push(Frame(FrameID(0), solver._start_index, _number_of_formulas,
+                    _bw_eventualities_lut.size()));
+  _stack.top().hash = _zobrist[solver._start_index];
+  _touch_all();
+}
+
+template <size_t Words, unsigned Features>
+Tableau<Words, Features>::Tableau(const Tableau &master, WorkPool *pool)
+  : _options(master._options),
+    _state(State::INITIALIZED),
+    _result(Result::UNDEFINED),
+    _bitset(master._bitset),
+    _lhs(master._lhs),
+    _rhs(master._rhs),
+    _atom_set(master._atom_set),
+    _fw_eventualities_lut(master._fw_eventualities_lut),
+    _bw_eventualities_lut(master._bw_eventualities_lut),
+    _number_of_formulas(master._number_of_formulas),
+    _start_index(master._start_index),
+    _loop_state(0),
+    _subformulas(master._subformulas),
+    _reasons(master._number_of_formulas, Reason{0, 0}),
+    _conflict(0),
+    _watches(master._number_of_formulas),
+    _zobrist(master._zobrist),
+    _shifts(master._shifts),
+    _alpha_closure(master._alpha_closure),
+    _complement(master._complement),
+    _clash(false),
+    _cache(size_t(master._options.cache_size) << 20),
+    _tainted(0),
+    _cache_depth(0),
+    _activity(master._activity),
+    _activity_increment(1.0),
+    _stats(),
+    _pool(pool),
+    _poll_counter(0),
+    _next_checkpoint(0)
+{
+  _options.threads = 1;
+
+  // The master counts the initial frame, workers only count their own work
+  _stats.maximum_frames = 0;
+  _stats.total_frames = 0;
+  _stats.maximum_model_size = 0;
+  _touch_all();
+}
+
+// Walks the words of the top frame once, computing in the same pass what the
+// alpha rules and the beta rules would look at
+template <size_t Words, unsigned Features>
+typename Tableau<Words, Features>::RuleScan
+Tableau<Words, Features>::_scan_frame() const
+{
+  const Frame &frame = _stack.top();
+  const uint64_t *formulas = frame.formulas.words();
+  const uint64_t *to_process = frame.to_process.words();
+
+  const uint64_t *beta_masks[] = {
+    _bitset.disjunction.words(), _bitset.eventually.words(),
+    _bitset.until.words(), _bitset.release.words()};
+
+  uint64_t any = 0;
+  uint64_t alpha = 0;
+  uint64_t beta_bits[4] = {0, 0, 0, 0};
+  size_t beta_word[4] = {0, 0, 0, 0};
+
+  // Going downwards, so that the last pending beta formula seen is the first
+  // one of its kind
+  for (size_t i = frame.formulas.num_words(); i-- > 0;) {
+    const uint64_t word = formulas[i];
+    const uint64_t pending = word & to_process[i];
+
+    any |= word;
+    alpha |= pending & _bitset.alpha.words()[i];
+
+    for (size_t k = 0; k < BETA_KINDS; ++k) {
+      const uint64_t bits = pending & beta_masks[k][i];
+      if (bits) {
+        beta_bits[k] = bits;
+        beta_word[k] = i;
+      }
+    }
+  }
+
+  RuleScan scan;
+  scan.empty = !any;
+  scan.alpha = alpha != 0;
+  scan.beta = FormulaID::max();
+
+  // Disjunctions first, then eventually, until and release
+  for (size_t k = 0; k < BETA_KINDS; ++k) {
+    if (beta_bits[k]) {
+      scan.beta = FormulaID(beta_word[k] * Bitset::bits_per_word +
+                            count_trailing_zeros(beta_bits[k]));
+      break;
+    }
+  }
+
+  return scan;
+}
+
+// Finds what the alpha rules and the beta rules would look at in the top
+// frame, looking again only at the words changed since the
+// last time, see ScanCache
+template <size_t Words, unsigned Features>
+typename Tableau<Words, Features>::RuleScan
+Tableau<Words, Features>::_scan_rules()
+{
+  if (Words != 0)
+    return _scan_frame();
+
+  for (size_t i = _scanned.dirty.find_first(); i != DynamicBitset::npos;
+       i = _scanned.dirty.find_next(i))
+    _rescan_word(i);
+  _scanned.dirty.reset();
+
+  RuleScan scan;
+  scan.empty = _scanned.any.none();
+  scan.alpha = _scanned.alpha.any();
+  scan.beta = FormulaID::max();
+
+  // Disjunctions first, then eventually, until and release
+  for (size_t k = 0; k < BETA_KINDS; ++k) {
+    const size_t i = _scanned.beta[k].find_first();
+    if (i != DynamicBitset::npos) {
+      scan.beta = FormulaID(i * Bitset::bits_per_word +
+                            count_trailing_zeros(_scanned.beta_bits[k][i]));
+      break;
+    }
+  }
+
+  return scan;
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_rescan_word(size_t i)
 {
   const Frame &frame = _stack.top();
+  const uint64_t *beta_masks[] = {
+    _bitset.disjunction.words(), _bitset.eventually.words(),
+    _bitset.until.words(), _bitset.release.words()};
 
-  _bitset.temporary = frame.formulas;
-  _bitset.temporary &= _bitset.negation;
-  _bitset.temporary >>= 1;
-  _bitset.temporary &= frame.formulas;
-  return _bitset.temporary.any();
+  const uint64_t word = frame.formulas.words()[i];
+  const uint64_t pending = word & frame.to_process.words()[i];
+
+  _scanned.any[i] = word != 0;
+  _scanned.alpha[i] = (pending & _bitset.alpha.words()[i]) != 0;
+
+  for (size_t k = 0; k < BETA_KINDS; ++k) {
+    const uint64_t bits = pending & beta_masks[k][i];
+    _scanned.beta_bits[k][i] = bits;
+    _scanned.beta[k][i] = bits != 0;
+  }
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_touch(size_t formula)
+{
+  if (Words != 0)
+    return;
+
+  _scanned.dirty.set(formula / Bitset::bits_per_word);
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_touch_all()
+{
+  if (Words != 0)
+    return;
+
+  const size_t words = _bitset.temporary.num_words();
+  if (_scanned.beta_bits[0].size() != words) {
+    _scanned.dirty = DynamicBitset(words);
+    _scanned.any = DynamicBitset(words);
+    _scanned.alpha = DynamicBitset(words);
+    for (size_t k = 0; k < BETA_KINDS; ++k) {
+      _scanned.beta[k] = DynamicBitset(words);
+      _scanned.beta_bits[k].assign(words, 0);
+    }
+  }
+
+  for (size_t i = 0; i < words; ++i)
+    _scanned.dirty.set(i);
 }
 
-// TODO: extract every conjunction, even when nested
-bool Solver::_apply_conjunction_rule()
+// Fills the closure of an alpha formula if no beta formula is below it, and
+// returns whether that is the case
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_build_alpha_closure(size_t formula,
+                                                    std::vector<bool> &visited)
+{
+  assert(_bitset.alpha[formula]);
+  if (visited[formula])
+    return _bitset.beta_free[formula];
+  visited[formula] = true;
+
+  FormulaID children[] = {_lhs[formula], _rhs[formula]};
+  if (_bitset.always[formula]) {
+    assert(_bitset.tomorrow[formula + 1] &&
+           _lhs[formula + 1] == FormulaID(formula));
+    children[1] = FormulaID(formula + 1);
+  }
+
+  bool beta_free = true;
+  for (FormulaID child : children) {
+    if (_bitset.beta[child] ||
+        (_bitset.alpha[child] && !_build_alpha_closure(child, visited)))
+      beta_free = false;
+  }
+
+  if (!beta_free)
+    return false;
+
+  Bitset &closure = _alpha_closure[formula];
+  closure = Bitset(_number_of_formulas);
+  closure.set(formula);
+  for (FormulaID child : children) {
+    closure.set(child);
+    if (_bitset.alpha[child])
+      closure |= _alpha_closure[child];
+  }
+
+  _bitset.beta_free.set(formula);
+  return true;
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_add_alpha_closure(Frame &frame, size_t formula)
+{
+  const Bitset &closure = _alpha_closure[formula];
+  const uint64_t reason = _reason(formula);
+  for (size_t f = closure.find_first(); f != Bitset::npos;
+       f = closure.find_next(f)) {
+    _add_formula(frame, f, reason);
+    if (_bitset.alpha[f] && frame.to_process[f])
+      _set_processed(frame, f);
+  }
+}
+
+// Applies the alpha rules a level at a time until a beta formula is pending,
+// as the branching policies only choose among the betas of the shallowest
+// level that has any. Below the beta free formulas there is nothing to
+// choose, so their whole closure is added at once.
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_apply_alpha_rules()
+{
+  const Frame &frame = _stack.top();
+  const uint64_t *formulas = frame.formulas.words();
+  const uint64_t *to_process = frame.to_process.words();
+  const uint64_t *beta = _bitset.beta.words();
+
+  bool applied = true;
+  while (applied && !_clash) {
+    applied = _apply_conjunction_rule();
+    applied = _apply_always_rule() || applied;
+
+    for (size_t i = 0; i < frame.formulas.num_words(); ++i)
+      if (formulas[i] & to_process[i] & beta[i])
+        return;
+  }
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_apply_conjunction_rule()
 {
   Frame &frame = _stack.top();
   _bitset.temporary = frame.formulas;
@@ -316,24 +793,32 @@ bool Solver::_apply_conjunction_rule()
   if (!_bitset.temporary.any())
     return false;
 
-  // TODO: find_first and find_next don't use __builtin_clz/__builtin_ctz, find
-  // if a custom implementation using them is faster
   size_t one = _bitset.temporary.find_first();
-  while (one != Bitset::npos) {
+  while (one != Bitset::npos && !_clash) {
     assert(_bitset.conjunction[one]);
     assert(frame.formulas[one]);
-    assert(frame.to_process[one]);
 
-    frame.formulas[_lhs[one]] = true;
-    frame.formulas[_rhs[one]] = true;
-    frame.to_process[one] = false;
+    // Unless the closure of a formula before it got here first
+    if (_bitset.beta_free[one]) {
+      if (frame.to_process[one]) {
+        _add_alpha_closure(frame, one);
+        ++_stats.rules[Stats::CONJUNCTION];
+      }
+    }
+    else {
+      _add_formula(frame, _lhs[one], _reason(one));
+      _add_formula(frame, _rhs[one], _reason(one));
+      _set_processed(frame, one);
+      ++_stats.rules[Stats::CONJUNCTION];
+    }
     one = _bitset.temporary.find_next(one);
   }
 
   return true;
 }
 
-bool Solver::_apply_always_rule()
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_apply_always_rule()
 {
   Frame &frame = _stack.top();
   _bitset.temporary = frame.formulas;
@@ -344,205 +829,374 @@ bool Solver::_apply_always_rule()
     return false;
 
   size_t one = _bitset.temporary.find_first();
-  while (one != Bitset::npos) {
+  while (one != Bitset::npos && !_clash) {
     assert(_bitset.always[one]);
     assert(frame.formulas[one]);
-    assert(frame.to_process[one]);
 
-    frame.formulas[_lhs[one]] = true;
-    assert(_bitset.tomorrow[one + 1] && _lhs[one + 1] == FormulaID(one));
-    frame.formulas[one + 1] = true;
-    frame.to_process[one] = false;
+    if (_bitset.beta_free[one]) {
+      if (frame.to_process[one]) {
+        _add_alpha_closure(frame, one);
+        ++_stats.rules[Stats::ALWAYS];
+      }
+    }
+    else {
+      _add_formula(frame, _lhs[one], _reason(one));
+      assert(_bitset.tomorrow[one + 1] && _lhs[one + 1] == FormulaID(one));
+      _add_formula(frame, one + 1, _reason(one));
+      _set_processed(frame, one);
+      ++_stats.rules[Stats::ALWAYS];
+    }
     one = _bitset.temporary.find_next(one);
   }
 
   return true;
 }
 
-#define APPLY_RULE(rule)                         \
-  bool Solver::_apply_##rule##_rule()            \
-  {                                              \
-    Frame &frame = _stack.top();                 \
-    _bitset.temporary = frame.formulas;          \
-    _bitset.temporary &= _bitset.rule;           \
-    _bitset.temporary &= frame.to_process;       \
-                                                 \
-    size_t one = _bitset.temporary.find_first(); \
-    if (one != Bitset::npos) {                   \
-      assert(_bitset.rule[one]);                 \
-      assert(frame.formulas[one]);               \
-      assert(frame.to_process[one]);             \
-                                                 \
-      frame.to_process[one] = false;             \
-      frame.choosen_formula = FormulaID(one);     \
-      frame.type = Frame::CHOICE;                \
-      return true;                               \
-    }                                            \
-                                                 \
-    return false;                                \
-  }
-
-APPLY_RULE(disjunction)
-APPLY_RULE(eventually)
-APPLY_RULE(until)
-APPLY_RULE(release)
-
-#undef APPLY_RULE
-
-uint32_t width[1000]={0};
+// The job of JOB_NO the i-th subtree met at the split depth belongs to: the
+// subtrees are dealt out to the jobs in rounds, each round rotated at random
+static uint32_t inline to_job(uint64_t i, uint32_t num_jobs)
+{
+  const uint32_t m = uint32_t(i % num_jobs);
+  uint64_t r = i / num_jobs;
+  if (!r)
+    return m;
 
-uint32_t num_jobs=1;
+  return uint32_t((splitmix64(r) + m) % num_jobs);
+}
 
-static uint32_t inline to_job (uint32_t i) {
-        uint32_t m = (i % num_jobs);
-        uint32_t r = (i / num_jobs);
-        if (r) {
-                srand(r); /*set random seed*/
-                return((rand()+m)%num_jobs);
-        }
-        else {  
-                return m;
-        }
+// The rule that branches on the given beta formula
+template <size_t Words, unsigned Features>
+Solver::Stats::Rule Tableau<Words, Features>::_beta_rule(
+  FormulaID formula) const
+{
+  if (_bitset.disjunction[formula])
+    return Stats::DISJUNCTION;
+  if (_bitset.eventually[formula])
+    return Stats::EVENTUALLY;
+  if (_bitset.until[formula])
+    return Stats::UNTIL;
+  return Stats::RELEASE;
 }
 
-Solver::Result Solver::solution()
+// The pending beta formula of the top frame to branch on, according to
+// Options::branching. Ties go the way of Branching::FIXED.
+template <size_t Words, unsigned Features>
+FormulaID Tableau<Words, Features>::_choose_beta() const
+{
+  const Frame &frame = _stack.top();
+
+  auto kind = [this](FormulaID f) {
+    return _bitset.disjunction[f] ? 0 : _bitset.eventually[f]
+                                          ? 1
+                                          : _bitset.until[f] ? 2 : 3;
+  };
+
+  auto score = [&](FormulaID f) -> double {
+    switch (_options.branching) {
+      case Branching::FEWEST_NEW:
+        return double(_new_formulas(frame, f));
+
+      case Branching::EVENTUALITIES: {
+        if (!_bitset.eventually[f] && !_bitset.until[f])
+          return 2;
+
+        const FormulaID goal = _bitset.eventually[f] ? _lhs[f] : _rhs[f];
+        const Eventuality ev = frame.eventualities[_fw_eventualities_lut[goal]];
+        return ev.is_not_satisfied() ? 0 : 1;
+      }
+
+      case Branching::ACTIVITY:
+        return -_activity[f];
+
+      case Branching::FIXED:
+        break;
+    }
+
+    return 0;
+  };
+
+  FormulaID best = FormulaID::max();
+  double best_score = 0;
+  int best_kind = 0;
+
+  for (size_t i = 0; i < frame.formulas.num_words(); ++i) {
+    uint64_t pending = frame.formulas.words()[i] &
+                       frame.to_process.words()[i] & _bitset.beta.words()[i];
+
+    while (pending) {
+      const FormulaID f =
+        FormulaID(i * Bitset::bits_per_word + count_trailing_zeros(pending));
+      pending &= pending - 1;
+
+      const double s = score(f);
+      const int k = kind(f);
+      if (best == FormulaID::max() || s < best_score ||
+          (s == best_score && k < best_kind)) {
+        best = f;
+        best_score = s;
+        best_kind = k;
+      }
+    }
+  }
+
+  return best;
+}
+
+// How many formulas not already in the frame the two alternatives of the rule
+// for one would add
+template <size_t Words, unsigned Features>
+size_t Tableau<Words, Features>::_new_formulas(const Frame &frame,
+                                              FormulaID one) const
+{
+  auto is_new = [&frame](FormulaID f) { return frame.formulas[f] ? 0 : 1; };
+
+  if (_bitset.disjunction[one])
+    return is_new(_lhs[one]) + is_new(_rhs[one]);
+  if (_bitset.eventually[one])
+    return is_new(_lhs[one]) + is_new(_postponed(one));
+  if (_bitset.until[one])
+    return is_new(_rhs[one]) + is_new(_lhs[one]) + is_new(_postponed(one));
+
+  assert(_bitset.release[one]);
+  return is_new(_lhs[one]) + 2 * is_new(_rhs[one]) +
+         is_new(_postponed(one));
+}
+
+// The choices taken in the top state led to a contradiction
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_bump_activity()
+{
+  for (auto it = _choices.rbegin();
+       it != _choices.rend() && it->states == _stack.size(); ++it)
+    _activity[it->formula] += _activity_increment;
+
+  _activity_increment /= 0.95;
+  if (_activity_increment > 1e100) {
+    for (double &a : _activity)
+      a *= 1e-100;
+    _activity_increment *= 1e-100;
+  }
+}
+
+template <size_t Words, unsigned Features>
+Solver::Result Tableau<Words, Features>::solution()
 {
   if (_state == State::RUNNING || _state == State::DONE)
     return _result;
 
-  if (_state == State::PAUSED)
+  Stopwatch stopwatch(_stats.seconds.search);
+
+  if (_options.threads > 1)
+    return _parallel_solution();
+
+  if (_state == State::PAUSED) {
+    _taint();
     _rollback_to_latest_choice();
+  }
 
   _state = State::RUNNING;
   bool rules_applied;
 
-uint32_t clock_depth=0;
-if (getenv("CLOCK_DEPTH"))
-     sscanf(getenv("CLOCK_DEPTH"),"%u",&clock_depth);
-
-bool     dump_depth=(getenv("DUMP_DEPTH")>NULL);
 uint32_t job_no=1;
+uint32_t num_jobs=1;
 uint32_t split_depth=1;
 uint32_t last_depth=0;
-if (! getenv("JOB_NO") || sscanf(getenv("JOB_NO"),"%u/%u@%u",&job_no,&num_jobs,&split_depth)<3) {
-    //std::cout << "\nTo use in parallel\n";
-    std::cout << "USAGE: JOB_NO=[job_no]/[number_of_jobs]@[split_depth] checker ...\n";
-    //std::cout << "e.g.: for i in 1 2 3; do JOB_NO=$i/3@7 checker ... ; done" << std::endl;
-    //std::cout << "\nAn example of when this doen't work well (only 2x speed up)" << std::endl;
-    //std::cout << "make && for i in `seq 1 1 7`; do JOB_NO=$i/17@7 timeout 30 time bin/checker -v 4  -l '(G (a => X (b|c))) & (G (b => X a)) & (G (c => X a)) & a & X X X X X X X X X X ~a'; done  2>&1 | tee out.txt" << std::endl;
-    //exit(1);
+// Workers of a multi-threaded search never split statically, nor do the
+// descents of estimate()
+if (_probe)
+  split_depth = 0;
+else if (!_pool && getenv("JOB_NO") && strstr(getenv("JOB_NO"), "@auto") &&
+         sscanf(getenv("JOB_NO"), "%u/%u", &job_no, &num_jobs) == 2) {
+  split_depth = estimate(AUTO_SPLIT_PROBES, num_jobs).split_depth;
+  format::info("Splitting the tableau at depth {}", split_depth);
+}
+else if (!_pool && getenv("JOB_NO") && sscanf(getenv("JOB_NO"),"%u/%u@%u",&job_no,&num_jobs,&split_depth)<3) {
+    format::error("JOB_NO should be [job_no]/[number_of_jobs]@[split_depth|auto]");
+}
+
+// Jobs of the same run can hand subtrees over to each other through JOB_POOL
+std::unique_ptr<JobPool> job_pool;
+if (!_pool && !_probe && getenv("JOB_NO") && getenv("JOB_POOL"))
+  job_pool.reset(new JobPool(getenv("JOB_POOL"), _fingerprint(false)));
+
+// Continue from where a previous run saved the search, see Options::resume
+if (!_options.resume.empty()) {
+  if (_load_checkpoint(last_depth, split_depth))
+    format::info("Resuming the search after {} frames", _stats.total_frames);
+  _options.resume.clear();
 }
+_cache_depth = num_jobs > 1 ? split_depth : 0;
+_next_checkpoint = _stats.total_frames + _options.checkpoint_interval;
 
 loop:
   while (!_stack.empty()) {
-    Frame &frame = _stack.top();
-    //std::cout << "D" << _stack.size() << "," << frame.id << "," << not_reach_end << rules_applied <<"\n";
-    assert(_stack.size() <= split_depth || job_no > 0);
-    if (_stack.size() > last_depth && _stack.size() < 1000) {
-      if(dump_depth) printf ("%lu\n", _stack.size()); 
-      width[_stack.size()]++;
-      if (_stack.size() <= clock_depth)
-        std::cout << "^" << _stack.size() << ":" << clock() << "\n";
-    }
-    if (_stack.size() == split_depth && last_depth < split_depth) {
-      if ( to_job(width[_stack.size()]-1) != (job_no-1) )   {
-         while (_stack.size() >= split_depth) 
-         	_rollback_to_latest_choice();
-         //rules_applied = false;
-         last_depth=_stack.size();
-         //std::cout << "H" << hash << "," << job_no << "/" << num_of_job << std::endl;
-         goto loop;
+    // Once in a while, look at what happens outside of this search
+    if ((++_poll_counter & (POLL_INTERVAL - 1)) == 0) {
+      if (_options.stop && _options.stop->load(std::memory_order_relaxed)) {
+        if (!_options.checkpoint.empty())
+          _save_checkpoint(last_depth, split_depth);
+        _state = State::DONE;
+        return _result;
       }
-    }
-    last_depth=_stack.size();
 
-    //last_depth=_stack.size();
+      if (!_options.checkpoint.empty() && _options.checkpoint_interval &&
+          _stats.total_frames >= _next_checkpoint) {
+        _save_checkpoint(last_depth, split_depth);
+        _next_checkpoint = _stats.total_frames + _options.checkpoint_interval;
+      }
 
-    rules_applied = true;
-    while (rules_applied) {
-      rules_applied = false;
+      if (_pool && _pool->done) {
+        _state = State::DONE;
+        return _result;
+      }
 
-      if (__builtin_expect(frame.formulas.none(), 0)) {
-        _state = State::PAUSED;
-        _result = Result::SATISFIABLE;
-        _loop_state = frame.chain->id;
+      if (_pool && _pool->hungry)
+        _share_work();
 
-		_print_stats();
+      if (job_pool && (_poll_counter & (JOB_POOL_POLL_INTERVAL - 1)) == 0) {
+        if (job_pool->stopped()) {
+          _state = State::DONE;
+          return _result;
+        }
 
-        return _result;
+        // Only the frames from the split depth up belong to this job alone
+        WorkItem item;
+        item.fingerprint = job_pool->fingerprint();
+        if (job_pool->hungry() &&
+            _export_work(item, split_depth > 0 ? split_depth - 1 : 0))
+          job_pool->offer(item);
       }
+    }
 
-      if (_check_contradiction_rule()) {
+    Frame &frame = _stack.top();
+    assert(_depth() <= split_depth || job_no > 0 || job_pool);
+    if (__builtin_expect(_probe != nullptr, 0)) {
+      // Random branches can postpone eventualities for very long before
+      // being pruned, which the search would rarely follow that far
+      if (_depth() > last_depth && !_probe->visit(_depth(), _choices.size())) {
         _rollback_to_latest_choice();
-        ++_stats.total_frames;
-        ++_stats.cross_by_contradiction;
         goto loop;
       }
+    }
+    else if (_depth() > last_depth) {
+      if (_stats.width.size() <= _depth())
+        _stats.width.resize(_depth() + 1, 0);
+      ++_stats.width[_depth()];
+    }
+    if (_depth() == split_depth && last_depth < split_depth) {
+      if (to_job(_stats.width[_depth()] - 1, num_jobs) != job_no - 1) {
+        ++_stats.cross_by_split;
+        _taint();
+        while (_depth() >= split_depth)
+          _rollback_to_latest_choice();
+        last_depth = _depth();
+        goto loop;
+      }
+    }
+    last_depth = _depth();
 
-      if (_apply_conjunction_rule())
-        rules_applied = true;
-      if (_apply_always_rule())
-        rules_applied = true;
-
-      if (_apply_disjunction_rule()) {
-        Frame new_frame(frame);
-        new_frame.formulas[_lhs[frame.choosen_formula]] = true;
-        _stack.push(std::move(new_frame));
+    rules_applied = true;
+    while (rules_applied) {
+      rules_applied = false;
 
+      if (_clash) {
+        if (_options.branching == Branching::ACTIVITY)
+          _bump_activity();
+        _backjump();
         ++_stats.total_frames;
-        _stats.maximum_frames = std::max(
-          _stats.maximum_frames, static_cast<uint64_t>(_stack.size()));
+        ++_stats.cross_by_contradiction;
+        goto loop;
+      }
+
+      RuleScan scan = PROFILED(SCAN, _scan_rules());
 
+      if (_options.sat && !scan.empty &&
+          (scan.alpha || scan.beta != FormulaID::max())) {
+        if (!PROFILED(EXPANSION, _expand_state())) {
+          _rollback_to_latest_choice();
+          ++_stats.total_frames;
+          ++_stats.cross_by_contradiction;
+        }
         goto loop;
       }
 
-	  // TODO: Don't generate eventualities here at all
-      if (_has_eventually && _apply_eventually_rule()) {
-        auto &ev =
-          frame.eventualities[_fw_eventualities_lut[_lhs[frame.choosen_formula]]];
+      if (__builtin_expect(scan.empty, 0)) {
+        _state = State::PAUSED;
+        _result = Result::SATISFIABLE;
+        _loop_state = frame.chain->id;
 
-        if (__builtin_expect(ev.is_not_requested(), 0))
-          ev.set_not_satisfied();
+        if (job_pool) {
+          job_pool->satisfiable();
+          job_pool.reset();
+        }
 
-        Frame new_frame(frame);
-        new_frame.formulas[_lhs[frame.choosen_formula]] = true;
-        _stack.push(std::move(new_frame));
+        return _result;
+      }
 
-        ++_stats.total_frames;
-        _stats.maximum_frames = std::max(_stats.maximum_frames,
-                                         static_cast<uint64_t>(_stack.size()));
+      if (scan.alpha) {
+        PROFILED(ALPHA, _apply_alpha_rules());
+        rules_applied = true;
 
-        goto loop;
+        // The alpha rules may have stopped at a contradiction, to catch
+        // before branching, or added beta formulas
+        if (_clash)
+          continue;
+        scan = PROFILED(SCAN, _scan_rules());
       }
 
-      if (_has_until && _apply_until_rule())
-	  {
-        auto &ev =
-          frame.eventualities[_fw_eventualities_lut[_rhs[frame.choosen_formula]]];
-        if (__builtin_expect(ev.is_not_requested(), 0))
-          ev.set_not_satisfied();
+      // The scan has already found the choice of Branching::FIXED
+      if (scan.beta != FormulaID::max() &&
+          _options.branching != Branching::FIXED)
+        scan.beta = _choose_beta();
+
+      if (scan.beta != FormulaID::max()) {
+        PROFILE_SCOPE(BETA);
+        const FormulaID one = scan.beta;
+
+        bool first = true;
+        bool second = true;
+        if (_options.lookahead) {
+          first = !_fails(_alternative(one, true));
+          second = !_fails(_alternative(one, false));
+
+          // The frame is contradictory whichever way, because of any of the
+          // choices taken in it for all we know
+          if (!first && !second) {
+            _clash = true;
+            _conflict = _reason(one) | _levels_below(_local_choices());
+            goto loop;
+          }
+        }
 
-        Frame new_frame(frame);
-        new_frame.formulas[_rhs[frame.choosen_formula]] = true;
-        _stack.push(std::move(new_frame));
+        _set_processed(frame, one);
+        ++_stats.rules[_beta_rule(one)];
 
-        ++_stats.total_frames;
-        _stats.maximum_frames = std::max(_stats.maximum_frames,
-                                         static_cast<uint64_t>(_stack.size()));
+        // TODO: Don't generate eventualities here at all
+        _request_eventuality(frame, one);
 
-        goto loop;
-      }
+        if (!first || !second) {
+          _add_alternative(frame, _alternative(one, first),
+                           _reason(one) | _levels_below(_local_choices()));
+          ++_stats.forced_by_lookahead;
+          goto loop;
+        }
+
+        // Both alternatives start from here, the first one is explored in
+        // place and undone by _rollback_to_latest_choice()
+        // A descent of estimate() takes either one, for good
+        const bool taken = !_probe || (splitmix64(_probe->random) & 1);
+        const size_t level = _local_choices();
+        _choices.push_back({one, _trail.size(), _stack.size(), !_probe,
+                            uint32_t(level), ~uint64_t(0),
+                            _reason_trail.size()});
+        ++_stats.choices;
 
-      if (_has_release && _apply_release_rule())
-	  {
-        Frame new_frame(frame);
-        new_frame.formulas[_lhs[frame.choosen_formula]] = true;
-        new_frame.formulas[_rhs[frame.choosen_formula]] = true;
-        _stack.push(std::move(new_frame));
+        _add_alternative(frame, _alternative(one, taken),
+                         _reason(one) | _level_bit(level));
 
         ++_stats.total_frames;
-        _stats.maximum_frames = std::max(_stats.maximum_frames,
-                                         static_cast<uint64_t>(_stack.size()));
+        _stats.maximum_frames =
+          std::max(_stats.maximum_frames, static_cast<uint64_t>(_depth()));
 
         goto loop;
       }
@@ -551,52 +1205,72 @@ loop:
         goto loop;
     }
 
-    _update_eventualities_satisfaction();
-    _update_history();
+    PROFILED(EVENTUALITIES, _update_eventualities_satisfaction());
+    PROFILED(HISTORY, _update_history());
 
     bool loop_result = false;
 
-    std::tie(loop_result, _loop_state) = _check_loop_rule();
+    std::tie(loop_result, _loop_state) = PROFILED(LOOP, _check_loop_rule());
     if (loop_result)
 	{
+      ++_stats.rules[Stats::LOOP];
       _result = Result::SATISFIABLE;
       _state = State::PAUSED;
 
-	  _print_stats();
+      if (job_pool) {
+        job_pool->satisfiable();
+        job_pool.reset();
+      }
 
       return _result;
     }
 
-    if (_check_prune0_rule() || _check_prune_rule())
-	{
-      _rollback_to_latest_choice();
-      ++_stats.total_frames;
-      ++_stats.cross_by_prune;
-      goto loop;
+    if (Features & FEATURE_EVENTUALITIES) {
+      const bool prune0 = PROFILED(PRUNE0, _check_prune0_rule());
+      if (prune0 || PROFILED(PRUNE, _check_prune_rule())) {
+        _taint();
+        _rollback_to_latest_choice();
+        ++_stats.total_frames;
+        ++_stats.cross_by_prune;
+        ++_stats.rules[prune0 ? Stats::PRUNE0 : Stats::PRUNE];
+        goto loop;
+      }
     }
 
-    if (frame.id >= _maximum_depth)
+    if (frame.id >= _options.maximum_depth)
 	{
+      _taint();
       _rollback_to_latest_choice();
       ++_stats.total_frames;
+      ++_stats.cross_by_depth;
       goto loop;
     }
 
-    Frame new_frame(frame.id + 1, _number_of_formulas, frame.eventualities,
-                    &frame);
     _bitset.temporary = frame.formulas;
     _bitset.temporary &= _bitset.tomorrow;
 
-    for (uint64_t i = 0; i < _number_of_formulas; ++i) {
-      if (_bitset.temporary[i]) {
-        assert(frame.formulas[i]);
-        assert(_bitset.tomorrow[i]);
-        new_frame.formulas[_lhs[i]] = true;
+    if (_cache.enabled() && _depth() >= _cache_depth) {
+      if (PROFILED(CACHE, _cache.contains(_bitset.temporary))) {
+        _rollback_to_latest_choice();
+        ++_stats.total_frames;
+        ++_stats.cache_hits;
+        goto loop;
       }
+
+      ++_stats.cache_misses;
     }
 
     frame.type = Frame::STEP;
-    _stack.push(std::move(new_frame));
+    _remember(frame);
+    ++_stats.rules[Stats::STEP];
+
+    // Built in the place of the last frame popped from there, if any
+    Frame &new_frame = _stack.emplace(frame.id + 1, _number_of_formulas,
+                                      frame.eventualities, &frame);
+
+    PROFILED(STEP, _build_successor(new_frame));
+    _clash = PROFILED(CONTRADICTION, _has_clash(new_frame));
+    _touch_all();
 
     ++_stats.total_frames;
 
@@ -604,68 +1278,953 @@ loop:
       _stats.maximum_model_size, static_cast<uint64_t>(_stack.top().id));
   }
 
+  if (_pool && _acquire_work())
+    goto loop;
+
+  if (job_pool) {
+    WorkItem item;
+    if (job_pool->acquire(item)) {
+      // Subtrees from the pool belong to us alone, never split them again
+      split_depth = 0;
+      _cache_depth = 0;
+      if (_fits(item) && item.links.back().type == Frame::CHOICE)
+        _import_work(item);
+      goto loop;
+    }
+
+    if (job_pool->stopped()) {
+      _state = State::DONE;
+      return _result;
+    }
+  }
+
   _state = State::DONE;
   if (_result == Result::UNDEFINED)
     _result = Result::UNSATISFIABLE;
 
-  _print_stats();
-  
-  
-
   return _result;
 }
 
-void Solver::_update_eventualities_satisfaction()
+template <size_t Words, unsigned Features>
+Solver::Result Tableau<Words, Features>::_parallel_solution()
 {
-  Frame &frame = _stack.top();
+  // Resuming the search after a model has been found is not supported, since
+  // the other workers have already been stopped
+  if (_state == State::PAUSED)
+    return _result;
 
-  uint64_t i = 0;
-  std::for_each(frame.eventualities.begin(), frame.eventualities.end(),
-                [&](Eventuality &ev) {
-                  if (frame.formulas[_bw_eventualities_lut[i]])
-                    ev.set_satisfied(frame.id);
-                  ++i;
-                });
+  _state = State::RUNNING;
+
+  if (getenv("JOB_NO"))
+    format::error("JOB_NO is ignored when running with {} threads",
+                  _options.threads);
+
+  WorkPool pool(_options.threads);
+  std::vector<std::unique_ptr<Tableau>> workers;
+  for (uint32_t i = 0; i < _options.threads; ++i)
+    workers.emplace_back(new Tableau(*this, &pool));
+
+  // The first worker starts from the root, the others immediately ask for work
+  workers.front()->_stack.push(_stack.top());
+  workers.front()->_touch_all();
+  _stack.pop();
+
+  // The first worker to find a model, and whether the search was stopped
+  // through Options::stop, guarded by the mutex of the pool
+  Tableau *winner = nullptr;
+  bool stopped = false;
+
+  std::vector<std::thread> threads;
+  for (auto &worker : workers) {
+    Tableau *w = worker.get();
+    threads.emplace_back([w, &pool, &winner, &stopped] {
+      Result result = w->solution();
+      if (result == Result::UNSATISFIABLE)
+        return;
+
+      // Either way the workers waiting for work have to give up
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      if (result == Result::SATISFIABLE && !winner)
+        winner = w;
+      else if (!pool.done)
+        stopped = true;
+      pool.done = true;
+      pool.available.notify_all();
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  for (const auto &worker : workers) {
+    const Stats &stats = worker->_stats;
+    _stats.total_frames += stats.total_frames;
+    _stats.cross_by_contradiction += stats.cross_by_contradiction;
+    _stats.cross_by_prune += stats.cross_by_prune;
+    _stats.cross_by_depth += stats.cross_by_depth;
+    _stats.cross_by_split += stats.cross_by_split;
+    _stats.cache_hits += stats.cache_hits;
+    _stats.cache_misses += stats.cache_misses;
+    _stats.cache_evictions += stats.cache_evictions;
+    _stats.choices += stats.choices;
+    _stats.forced_by_lookahead += stats.forced_by_lookahead;
+    _stats.backjumps += stats.backjumps;
+    _stats.nogoods += stats.nogoods;
+    _stats.expansions += stats.expansions;
+    _stats.maximum_frames =
+      std::max(_stats.maximum_frames, stats.maximum_frames);
+    _stats.maximum_model_size =
+      std::max(_stats.maximum_model_size, stats.maximum_model_size);
+    for (size_t rule = 0; rule < Stats::NUMBER_OF_RULES; ++rule)
+      _stats.rules[rule] += stats.rules[rule];
+    if (_stats.width.size() < stats.width.size())
+      _stats.width.resize(stats.width.size(), 0);
+    for (size_t d = 0; d < stats.width.size(); ++d)
+      _stats.width[d] += stats.width[d];
+    _stats.profile += stats.profile;
+  }
+
+  if (winner) {
+    std::swap(_stack, winner->_stack);
+    std::swap(_choices, winner->_choices);
+    std::swap(_trail, winner->_trail);
+    std::swap(_reasons, winner->_reasons);
+    std::swap(_reason_trail, winner->_reason_trail);
+    std::swap(_nogoods, winner->_nogoods);
+    std::swap(_watches, winner->_watches);
+    std::swap(_bitset.watched, winner->_bitset.watched);
+    std::swap(_expansions, winner->_expansions);
+    std::swap(_history, winner->_history);
+    std::swap(_tainted, winner->_tainted);
+    _loop_state = winner->_loop_state;
+    _result = Result::SATISFIABLE;
+    _state = State::PAUSED;
+  }
+  else {
+    _result = stopped ? Result::UNDEFINED : Result::UNSATISFIABLE;
+    _state = State::DONE;
+  }
+
+  return _result;
 }
 
-void Solver::_update_history()
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_share_work()
 {
-  Frame *current_frame = _stack.top().chain;
-  Frame &top_frame = _stack.top();
+  std::unique_lock<std::mutex> lock(_pool->mutex);
+  if (_pool->items.size() >= _pool->hungry)
+    return;
+
+  WorkItem item;
+  if (!_export_work(item, 0))
+    return;
+
+  _pool->items.push_back(std::move(item));
+  _pool->available.notify_one();
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_acquire_work()
+{
+  std::unique_lock<std::mutex> lock(_pool->mutex);
+  ++_pool->idle;
+  ++_pool->hungry;
+
+  _pool->available.wait(lock, [this] {
+    return _pool->done || !_pool->items.empty() ||
+           _pool->idle == _pool->workers;
+  });
+
+  --_pool->hungry;
+
+  // Every worker is idle and nothing is left to explore
+  if (_pool->done || _pool->items.empty()) {
+    _pool->done = true;
+    _pool->available.notify_all();
+    return false;
+  }
+
+  --_pool->idle;
+  WorkItem item = std::move(_pool->items.front());
+  _pool->items.pop_front();
+  lock.unlock();
+
+  _import_work(item);
+
+  return true;
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_export_work(WorkItem &item, size_t lowest_frame)
+{
+  // The bottom-most pending choice at lowest_frame or above, in the depth
+  // counted by _depth(): below its point are the frames of the states before
+  // and the choices taken before. The models left to a SAT expansion cannot
+  // be handed over.
+  size_t c = 0;
+  while (c < _choices.size() &&
+         (!_choices[c].pending || _choices[c].formula == FormulaID::max() ||
+          _choices[c].states - 1 + c < lowest_frame))
+    ++c;
+
+  if (c == _choices.size())
+    return false;
+
+  Choice &choice = _choices[c];
+
+  // The changes made to the frame of the choice since it was taken
+  size_t end = _trail.size();
+  for (size_t i = c + 1; i < _choices.size(); ++i) {
+    if (_choices[i].states > choice.states) {
+      end = _choices[i].trail;
+      break;
+    }
+  }
+
+  Stack &frames = _stack;
+  std::unordered_map<const Frame *, size_t> index;
+  item.frames.reserve(choice.states);
+  item.links.reserve(choice.states);
+
+  auto index_of = [&index](const Frame *f) {
+    return f ? index.at(f) : WorkItem::NONE;
+  };
+
+  // Only the alternative of the top frame is handed over, the ones pending
+  // below lowest_frame may not be ours to give
+  for (size_t i = 0; i + 1 < choice.states; ++i) {
+    const Frame &f = frames[i];
+    index[&f] = i;
+    item.frames.push_back(detail::Frame<0>(f));
+    item.links.push_back({f.type, FormulaID::max(), index_of(f.chain),
+                          index_of(f.first), index_of(f.prev)});
+  }
+
+  const Frame &top = frames[choice.states - 1];
+  Frame snapshot(top);
+  _undo(snapshot, choice.trail, end);
+
+  item.frames.push_back(detail::Frame<0>(snapshot));
+  item.links.push_back({Frame::CHOICE, choice.formula, index_of(top.chain),
+                        WorkItem::NONE, WorkItem::NONE});
+
+  // The alternative now belongs to someone else, we must not explore it again
+  choice.pending = false;
+  _tainted = std::max(_tainted, choice.states);
+
+  return true;
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_fits(const WorkItem &item) const
+{
+  if (item.frames.empty())
+    return false;
+
+  // As many words as the frames of this width, with no formula past the last
+  // one (to_process has them all set from the start)
+  const size_t words = Bitset(_number_of_formulas).num_words();
+  auto beyond = [this](const DynamicBitset &bits) {
+    for (size_t i = _number_of_formulas; i < bits.size(); ++i)
+      if (bits[i])
+        return true;
+    return false;
+  };
+
+  for (size_t i = 0; i < item.frames.size(); ++i) {
+    const detail::Frame<0> &frame = item.frames[i];
+    const FormulaID formula = item.links[i].choosen_formula;
+
+    if (frame.formulas.num_words() != words ||
+        frame.to_process.num_words() != words || beyond(frame.formulas) ||
+        frame.eventualities.size() != _bw_eventualities_lut.size() ||
+        (formula >= _number_of_formulas && formula != FormulaID::max()))
+      return false;
+  }
+
+  return true;
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_import_work(const WorkItem &item)
+{
+  assert(_stack.empty() && _choices.empty() && _trail.empty());
+  assert(std::all_of(_history.begin(), _history.end(),
+                     [](const Frame *f) { return f == nullptr; }));
+
+  std::vector<Frame *> frames;
+  for (const auto &f : item.frames) {
+    _stack.push(Frame(f));
+    frames.push_back(&_stack.top());
+  }
+
+  auto frame_at = [&frames](size_t i) {
+    return i == WorkItem::NONE ? nullptr : frames[i];
+  };
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const WorkItem::Links &links = item.links[i];
+    frames[i]->type = links.type;
+    frames[i]->chain = frame_at(links.chain);
+    frames[i]->first = frame_at(links.first);
+    frames[i]->prev = frame_at(links.prev);
+    frames[i]->hash = _hash(*frames[i]);
+
+    if (i + 1 < frames.size())
+      _remember(*frames[i]);
+  }
+
+  // The top frame is the choice point we took over: explore its alternative
+  const WorkItem::Links &top = item.links.back();
+  assert(top.type == Frame::CHOICE);
+
+  _stack.top().type = Frame::UNKNOWN;
+  _touch_all();
+  _taint();
+  _choices.push_back({top.choosen_formula, 0, _stack.size(), true, 0,
+                      ~uint64_t(0), _reason_trail.size()});
+  _rollback_to_latest_choice();
+}
+
+// The descents run on a copy of the tableau without the cache of crossed
+// subtrees, which would take the branches they leave behind for closed. They
+// are seeded the same way every time, so that every job of JOB_NO=i/n@auto
+// picks the same split depth.
+template <size_t Words, unsigned Features>
+Solver::Estimate Tableau<Words, Features>::estimate(uint32_t probes,
+                                                    uint32_t jobs)
+{
+  Tableau probe(*this, nullptr);
+  probe._cache = CrossedCache<Words>();
+  probe._options.sat = false;
+  probe._options.checkpoint.clear();
+  probe._options.resume.clear();
+  probe._probe.reset(new Probe());
+
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < probes; ++i) {
+    // Back to the root, wherever the last descent stopped
+    probe._stack.clear();
+    probe._choices.clear();
+    probe._trail.clear();
+    probe._reason_trail.clear();
+    probe._forget_nogoods();
+    std::fill(probe._reasons.begin(), probe._reasons.end(), Reason{0, 0});
+    std::fill(probe._history.begin(), probe._history.end(), nullptr);
+    probe._clash = false;
+    probe._tainted = 0;
+    probe._state = State::INITIALIZED;
+    probe._result = Result::UNDEFINED;
+    probe._probe->choices = 0;
+
+    probe._stack.push(Frame(FrameID(0), _start_index, _number_of_formulas,
+                            _bw_eventualities_lut.size()));
+    probe._stack.top().hash = _zobrist[_start_index];
+    probe._touch_all();
+    probe.solution();
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  Solver::Estimate estimate;
+  if (probes == 0)
+    return estimate;
+
+  const Probe &descents = *probe._probe;
+  estimate.frames = descents.nodes / probes;
+  for (double width : descents.width)
+    estimate.width.push_back(width / probes);
+  if (descents.visited > 0)
+    estimate.seconds =
+      estimate.frames * elapsed.count() / double(descents.visited);
+
+  estimate.jobs = jobs;
+  if (jobs == 0)
+    estimate.jobs = uint32_t(std::max(
+      1.0, std::min(double(MAX_JOBS),
+                    std::floor(estimate.seconds / MIN_JOB_SECONDS))));
+
+  // Or the widest depth, if none has enough
+  size_t widest = 1;
+  estimate.split_depth = 0;
+  for (size_t d = 1; d < estimate.width.size() && !estimate.split_depth;
+       ++d) {
+    if (estimate.width[d] >= SUBTREES_PER_JOB * estimate.jobs)
+      estimate.split_depth = uint32_t(d);
+    if (estimate.width[d] > estimate.width[widest])
+      widest = d;
+  }
+  if (!estimate.split_depth)
+    estimate.split_depth = uint32_t(widest);
+
+  return estimate;
+}
+
+// Of the two alternatives of a choice, Stats::width counts the first one
+// only, the second one starting at the same depth: half the nodes a node
+// reached by a choice stands for
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::Probe::visit(size_t depth, size_t above)
+{
+  if (depth > MAX_PROBE_DEPTH)
+    return false;
+
+  const bool chosen = above > choices;
+  choices = above;
+
+  ++visited;
+  nodes += std::ldexp(1.0, int(above));
+  if (width.size() <= depth)
+    width.resize(depth + 1, 0.0);
+  width[depth] += std::ldexp(1.0, int(above) - (chosen ? 1 : 0));
+
+  return true;
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_save_checkpoint(uint32_t last_depth,
+                                                uint32_t split_depth) const
+{
+  // Written aside and renamed over the previous one, so that being killed
+  // meanwhile leaves the last complete checkpoint in place
+  const std::string temporary = _options.checkpoint + ".tmp";
+  std::ostringstream os;
+
+  write_word(os, CHECKPOINT_MAGIC);
+  write_word(os, _fingerprint());
+
+  std::unordered_map<const Frame *, size_t> index;
+  for (size_t i = 0; i < _stack.size(); ++i)
+    index[&_stack[i]] = i;
+
+  auto index_of = [&index](const Frame *f) {
+    return f ? index.at(f) : WorkItem::NONE;
+  };
+
+  WorkItem branch;
+  for (size_t i = 0; i < _stack.size(); ++i) {
+    const Frame &f = _stack[i];
+    branch.frames.push_back(detail::Frame<0>(f));
+    branch.links.push_back({f.type, FormulaID::max(), index_of(f.chain),
+                            index_of(f.first), index_of(f.prev)});
+  }
+  write_work_item(os, branch);
+
+  write_word(os, _choices.size());
+  for (const Choice &choice : _choices) {
+    write_word(os, choice.formula);
+    write_word(os, choice.trail);
+    write_word(os, choice.states);
+    write_word(os, choice.pending);
+    write_word(os, choice.level);
+    write_word(os, choice.reason);
+    write_word(os, choice.reasons);
+  }
+
+  write_word(os, _trail.size());
+  for (const Change &change : _trail) {
+    write_word(os, change.kind);
+    write_word(os, change.index);
+    write_word(os, change.eventuality);
+  }
+
+  for (const Reason &reason : _reasons) {
+    write_word(os, reason.choices);
+    write_word(os, reason.states);
+  }
+
+  write_word(os, _reason_trail.size());
+  for (const auto &entry : _reason_trail) {
+    write_word(os, entry.first);
+    write_word(os, entry.second.choices);
+    write_word(os, entry.second.states);
+  }
+
+  write_word(os, _nogoods.size());
+  for (const Nogood &nogood : _nogoods) {
+    write_word(os, nogood.size);
+    write_word(os, nogood.states);
+    for (size_t i = 0; i < nogood.size; ++i)
+      write_word(os, nogood.formulas[i]);
+  }
+
+  for (double activity : _activity)
+    write_double(os, activity);
+  write_double(os, _activity_increment);
+
+  write_word(os, _clash);
+  write_word(os, _conflict);
+  write_word(os, _tainted);
+  write_word(os, _poll_counter);
+
+  for (auto field : SAVED_STATS)
+    write_word(os, _stats.*field);
+  for (uint64_t applied : _stats.rules)
+    write_word(os, applied);
+  write_double(os, _stats.seconds.search);
+
+  write_word(os, _stats.width.size());
+  for (uint64_t width : _stats.width)
+    write_word(os, width);
+
+  write_word(os, last_depth);
+  write_word(os, split_depth);
+
+  // Followed by a checksum of all the above, which tells damaged files apart
+  const std::string bytes = os.str();
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), std::streamsize(bytes.size()));
+  write_word(file, fnv1a(FNV_OFFSET_BASIS, bytes));
+
+  file.close();
+  if (!file ||
+      std::rename(temporary.c_str(), _options.checkpoint.c_str()) != 0)
+    format::error("Unable to write the checkpoint \"{}\"", _options.checkpoint);
+  else
+    format::debug("Checkpoint saved after {} frames", _stats.total_frames);
+}
+
+// Everything is read before anything is changed, the saved frames replacing
+// the initial one as _import_work() would
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_load_checkpoint(uint32_t &last_depth,
+                                                uint32_t &split_depth)
+{
+  std::ifstream file(_options.resume, std::ios::binary);
+  if (!file) {
+    format::error("Unable to open the checkpoint \"{}\"", _options.resume);
+    return false;
+  }
+
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  std::string bytes = contents.str();
+  uint64_t checksum = 0;
+  const bool intact = bytes.size() >= sizeof(checksum);
+  if (intact) {
+    std::memcpy(&checksum, bytes.data() + bytes.size() - sizeof(checksum),
+                sizeof(checksum));
+    bytes.resize(bytes.size() - sizeof(checksum));
+  }
+  std::istringstream is(bytes);
+
+  if (read_word(is) != CHECKPOINT_MAGIC || read_word(is) != _fingerprint()) {
+    format::error("The checkpoint \"{}\" is not of this formula with these "
+                  "options, starting from scratch",
+                  _options.resume);
+    return false;
+  }
+
+  WorkItem branch;
+  bool valid = intact && checksum == fnv1a(FNV_OFFSET_BASIS, bytes) &&
+               read_work_item(is, branch) && _fits(branch);
+  const size_t states = branch.frames.size();
+
+  // Whatever is read from here on indexes the branch, the closure or what
+  // was read before, and is checked against them
+  std::vector<Choice> choices(valid ? read_count(is, 7 * sizeof(uint64_t)) : 0);
+  for (size_t c = 0; c < choices.size(); ++c) {
+    Choice &choice = choices[c];
+    choice.formula = FormulaID(read_word(is));
+    choice.trail = read_word(is);
+    choice.states = read_word(is);
+    choice.pending = read_word(is) != 0;
+    choice.level = uint32_t(read_word(is));
+    choice.reason = read_word(is);
+    choice.reasons = read_word(is);
+
+    // Always on a beta formula, never one of --sat, which is not saved
+    const Choice *before = c > 0 ? &choices[c - 1] : nullptr;
+    valid = valid && choice.formula < _number_of_formulas &&
+            _bitset.beta[choice.formula] && choice.states > 0 && choice.states <= states && choice.level <= c &&
+            (!before || (choice.states >= before->states &&
+                         choice.trail >= before->trail &&
+                         choice.reasons >= before->reasons));
+  }
+
+  std::vector<Change> trail(valid ? read_count(is, 3 * sizeof(uint64_t)) : 0);
+  for (Change &change : trail) {
+    const uint64_t kind = read_word(is);
+    change.kind = typename Change::Kind(kind);
+    change.index = uint32_t(read_word(is));
+    change.eventuality = read_eventuality(is).id();
+
+    valid = valid && kind <= Change::EVENTUALITY &&
+            change.index < (kind == Change::EVENTUALITY
+                              ? _bw_eventualities_lut.size()
+                              : _number_of_formulas);
+  }
+
+  std::vector<Reason> reasons(_number_of_formulas);
+  for (Reason &reason : reasons) {
+    reason.choices = read_word(is);
+    reason.states = read_word(is);
+  }
+
+  std::vector<std::pair<FormulaID, Reason>> reason_trail(
+    valid ? read_count(is, 3 * sizeof(uint64_t)) : 0);
+  for (auto &entry : reason_trail) {
+    entry.first = FormulaID(read_word(is));
+    entry.second.choices = read_word(is);
+    entry.second.states = read_word(is);
+    valid = valid && entry.first < _number_of_formulas;
+  }
+
+  valid = valid && (choices.empty() || (choices.back().trail <= trail.size() &&
+                                        choices.back().reasons <=
+                                          reason_trail.size()));
+
+  std::vector<Nogood> nogoods(valid ? read_count(is, 2 * sizeof(uint64_t)) : 0);
+  valid = valid && nogoods.size() <= MAX_NOGOODS;
+  for (size_t n = 0; valid && n < nogoods.size(); ++n) {
+    Nogood &nogood = nogoods[n];
+    nogood.size = read_word(is);
+    nogood.states = read_word(is);
+    valid = valid && nogood.size <= MAX_NOGOOD_SIZE;
+    for (size_t i = 0; valid && i < nogood.size; ++i) {
+      nogood.formulas[i] = FormulaID(read_word(is));
+      valid = nogood.formulas[i] < _number_of_formulas;
+    }
+  }
+
+  std::vector<double> activity(_number_of_formulas);
+  for (double &a : activity)
+    a = read_double(is);
+  const double activity_increment = read_double(is);
+
+  const bool clash = read_word(is) != 0;
+  const uint64_t conflict = read_word(is);
+  const size_t tainted = read_word(is);
+  const uint32_t poll_counter = uint32_t(read_word(is));
+  valid = valid && tainted <= states;
+
+  Stats stats;
+  for (auto field : SAVED_STATS)
+    stats.*field = read_word(is);
+  for (uint64_t &applied : stats.rules)
+    applied = read_word(is);
+  stats.seconds.search = read_double(is);
+
+  stats.width.resize(valid ? read_count(is, sizeof(uint64_t)) : 0);
+  for (uint64_t &w : stats.width)
+    w = read_word(is);
+
+  const uint32_t saved_last_depth = uint32_t(read_word(is));
+  const uint32_t saved_split_depth = uint32_t(read_word(is));
+
+  if (!valid || !is) {
+    format::error("The checkpoint \"{}\" is damaged, starting from scratch",
+                  _options.resume);
+    return false;
+  }
+
+  while (!_stack.empty())
+    _stack.pop();
+
+  std::vector<Frame *> frames;
+  for (const auto &f : branch.frames) {
+    _stack.push(Frame(f));
+    frames.push_back(&_stack.top());
+  }
+
+  auto frame_at = [&frames](size_t i) {
+    return i == WorkItem::NONE ? nullptr : frames[i];
+  };
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const WorkItem::Links &links = branch.links[i];
+    frames[i]->type = links.type;
+    frames[i]->chain = frame_at(links.chain);
+    frames[i]->first = frame_at(links.first);
+    frames[i]->prev = frame_at(links.prev);
+    frames[i]->hash = _hash(*frames[i]);
+
+    if (i + 1 < frames.size())
+      _remember(*frames[i]);
+  }
+
+  _choices = std::move(choices);
+  _trail = std::move(trail);
+  _reasons = std::move(reasons);
+  _reason_trail = std::move(reason_trail);
+
+  for (const Nogood &nogood : nogoods) {
+    for (size_t i = 0; i < nogood.size; ++i) {
+      _watches[nogood.formulas[i]].push_back(uint32_t(_nogoods.size()));
+      _bitset.watched.set(nogood.formulas[i]);
+    }
+    _nogoods.push_back(nogood);
+  }
+
+  _activity = std::move(activity);
+  _activity_increment = activity_increment;
+  _clash = clash;
+  _conflict = conflict;
+  _tainted = tainted;
+  _poll_counter = poll_counter;
+  _stats = std::move(stats);
+  last_depth = saved_last_depth;
+  split_depth = saved_split_depth;
+
+  _touch_all();
+
+  return true;
+}
+
+// Tells apart the closures, and the options and the job of JOB_NO that change
+// the shape of the tree
+template <size_t Words, unsigned Features>
+uint64_t Tableau<Words, Features>::_fingerprint(bool job) const
+{
+  PrettyPrinter printer;
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (const FormulaPtr &f : _subformulas)
+    hash = fnv1a(hash, printer.to_string(f) + "\n");
+
+  const char *job_no = job ? getenv("JOB_NO") : nullptr;
+  hash = fnv1a(hash, std::to_string(uint64_t(_options.maximum_depth)) + " " +
+                       std::to_string(int(_options.branching)) + " " +
+                       std::to_string(_options.seed) + " " +
+                       std::to_string(_options.lookahead) + " " +
+                       std::to_string(_options.learning) + " " +
+                       (job_no ? job_no : ""));
+
+  return hash;
+}
+
+// Only visits the goals present in the frame, a word at a time
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_update_eventualities_satisfaction()
+{
+  if (!(Features & FEATURE_EVENTUALITIES))
+    return;
+
+  Frame &frame = _stack.top();
+  const uint64_t *formulas = frame.formulas.words();
+  const uint64_t *goals = _bitset.goal.words();
+
+  for (size_t w = 0; w < frame.formulas.num_words(); ++w) {
+    for (uint64_t bits = formulas[w] & goals[w]; bits; bits &= bits - 1) {
+      const size_t goal = w * 64 + count_trailing_zeros(bits);
+      const size_t i = _fw_eventualities_lut[goal];
+      if (frame.eventualities[i].id() != frame.id)
+        _set_eventuality(frame, i, Eventuality::satisfied(frame.id));
+    }
+  }
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_update_history()
+{
+  Frame &top_frame = _stack.top();
+
+  Frame *current_frame = nullptr;
+  if (!_history.empty())
+    current_frame = _history[top_frame.hash & (_history.size() - 1)];
 
   while (current_frame) {
-    if (current_frame->formulas == top_frame.formulas) {
+    if (current_frame->hash == top_frame.hash &&
+        current_frame->formulas == top_frame.formulas) {
       top_frame.prev = current_frame;
       top_frame.first = current_frame->first;
       return;
     }
 
-    current_frame = current_frame->chain;
+    current_frame = current_frame->same_bucket;
   }
 
   top_frame.prev = &top_frame;
   top_frame.first = &top_frame;
 }
 
-std::pair<bool, FrameID> Solver::_check_loop_rule() const
+// Called when the frame stops being the top of the stack
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_remember(Frame &frame)
+{
+  if (_stack.size() > _history.size())
+    _grow_history();
+
+  Frame *&closest = _history[frame.hash & (_history.size() - 1)];
+  frame.same_bucket = closest;
+  closest = &frame;
+}
+
+// Called when the frame is the top of the stack again, which can only happen
+// to the last one remembered
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_forget(Frame &frame)
+{
+  Frame *&closest = _history[frame.hash & (_history.size() - 1)];
+  assert(closest == &frame);
+
+  closest = frame.same_bucket;
+  frame.same_bucket = nullptr;
+}
+
+// Doubles the buckets, splitting each one in two without changing the order
+// of its states
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_grow_history()
+{
+  std::vector<Frame *> buckets(_history.empty() ? 64 : 2 * _history.size(),
+                               nullptr);
+
+  for (size_t b = 0; b < _history.size(); ++b) {
+    Frame **tails[2] = {&buckets[b], &buckets[b + _history.size()]};
+
+    Frame *frame = _history[b];
+    while (frame) {
+      Frame *next = frame->same_bucket;
+      Frame **&tail = tails[(frame->hash & (buckets.size() - 1)) != b];
+
+      *tail = frame;
+      frame->same_bucket = nullptr;
+      tail = &frame->same_bucket;
+
+      frame = next;
+    }
+  }
+
+  _history.swap(buckets);
+}
+
+template <size_t Words, unsigned Features>
+uint64_t Tableau<Words, Features>::_hash(const Frame &frame) const
+{
+  uint64_t hash = 0;
+  for (size_t i = frame.formulas.find_first(); i != Bitset::npos;
+       i = frame.formulas.find_next(i))
+    hash ^= _zobrist[i];
+
+  return hash;
+}
+
+// Groups the tomorrow formulas by the distance from their argument, and gives
+// a mask to the distances shared by the most of them
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_build_shifts()
+{
+  std::unordered_map<size_t, size_t> formulas_at;
+  for (size_t i = 0; i < _number_of_formulas; ++i)
+    if (_bitset.tomorrow[i] && size_t(_lhs[i]) < i)
+      ++formulas_at[i - size_t(_lhs[i])];
+
+  // The most shared first, then the shortest
+  std::vector<std::pair<size_t, size_t>> distances(formulas_at.begin(),
+                                                   formulas_at.end());
+  std::sort(distances.begin(), distances.end(),
+            [](const std::pair<size_t, size_t> &a,
+               const std::pair<size_t, size_t> &b) {
+              return a.second != b.second ? a.second > b.second
+                                          : a.first < b.first;
+            });
+
+  // A lone formula is cheaper to move on its own than a whole mask
+  _shifts.clear();
+  for (const auto &distance : distances) {
+    if (_shifts.size() == MAX_SHIFTS || distance.second < 2)
+      break;
+    _shifts.push_back({distance.first, Bitset(_number_of_formulas)});
+  }
+
+  _bitset.sparse_tomorrow = Bitset(_number_of_formulas);
+  for (size_t i = 0; i < _number_of_formulas; ++i) {
+    if (!_bitset.tomorrow[i])
+      continue;
+
+    auto it = std::find_if(_shifts.begin(), _shifts.end(),
+                           [&](const Shift &shift) {
+                             return size_t(_lhs[i]) + shift.distance == i;
+                           });
+    if (it != _shifts.end())
+      it->mask.set(i);
+    else
+      _bitset.sparse_tomorrow.set(i);
+  }
+
+  format::debug("{} successor shifts, {} sparse tomorrow formulas",
+                _shifts.size(), _bitset.sparse_tomorrow.count());
+}
+
+// Fills the frame built by the STEP rule with the arguments of the tomorrow
+// formulas in _bitset.temporary
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_build_successor(Frame &next) const
+{
+  const size_t n = next.formulas.num_words();
+  const uint64_t *tomorrow = _bitset.temporary.words();
+  uint64_t *formulas = next.formulas.words();
+
+  for (const Shift &shift : _shifts) {
+    const size_t words = shift.distance / 64;
+    const size_t bits = shift.distance % 64;
+    const uint64_t *mask = shift.mask.words();
+
+    for (size_t i = 0; i + words < n; ++i) {
+      const uint64_t low = tomorrow[i + words] & mask[i + words];
+      const uint64_t high =
+        i + words + 1 < n ? tomorrow[i + words + 1] & mask[i + words + 1] : 0;
+      formulas[i] |= bits ? (low >> bits) | (high << (64 - bits)) : low;
+    }
+  }
+
+  const uint64_t *sparse = _bitset.sparse_tomorrow.words();
+  for (size_t w = 0; w < n; ++w)
+    for (uint64_t bits = tomorrow[w] & sparse[w]; bits; bits &= bits - 1)
+      next.formulas.set(_lhs[w * 64 + count_trailing_zeros(bits)]);
+
+  next.hash = _hash(next);
+}
+
+// Whether a formula and its negation are both in the frame, a word at a time
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_has_clash(const Frame &frame) const
+{
+  const uint64_t *formulas = frame.formulas.words();
+  const uint64_t *negation = _bitset.negation.words();
+
+  uint64_t clash = 0;
+  uint64_t negations_above = 0;
+  for (size_t i = frame.formulas.num_words(); i-- > 0;) {
+    const uint64_t negations = formulas[i] & negation[i];
+    clash |= ((negations >> 1) | (negations_above << 63)) & formulas[i];
+    negations_above = negations;
+  }
+
+  return clash != 0;
+}
+
+// The three rules below first try to decide from the counters kept by
+// Eventualities, and otherwise compare the eventualities a word at a time:
+// each word of satisfied_after() has the bits of those satisfied after the
+// given frame
+template <size_t Words, unsigned Features>
+std::pair<bool, FrameID> Tableau<Words, Features>::_check_loop_rule() const
 {
   const Frame &top_frame = _stack.top();
   const FrameID first_frame_id = top_frame.first->id;
 
   if (top_frame.first == &top_frame)
     return std::make_pair(false, FrameID(0));
+  if (!(Features & FEATURE_EVENTUALITIES))
+    return std::make_pair(true, first_frame_id);
 
-  bool ret =
-    std::all_of(top_frame.eventualities.begin(), top_frame.eventualities.end(),
-                [first_frame_id](Eventuality ev) {
-                  return ev.is_not_requested() ||
-                         (ev.is_satisfied() && ev.id() > first_frame_id);
-                });
+  // Every requested eventuality was satisfied after the first frame
+  const Eventualities &evs = top_frame.eventualities;
+  if (evs.unsatisfied_count() > 0)
+    return std::make_pair(false, first_frame_id);
+  if (evs.satisfied_count() == 0 || evs.earliest() > first_frame_id)
+    return std::make_pair(true, first_frame_id);
 
-  return std::make_pair(ret, first_frame_id);
+  for (size_t w = 0; w < evs.num_words(); ++w)
+    if (evs.requested(w) & ~evs.satisfied_after(w, first_frame_id))
+      return std::make_pair(false, first_frame_id);
+
+  return std::make_pair(true, first_frame_id);
 }
 
-bool Solver::_check_prune0_rule() const
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_check_prune0_rule() const
 {
   const Frame &top_frame = _stack.top();
   const FrameID prev_frame_id = top_frame.prev->id;
@@ -673,98 +2232,594 @@ bool Solver::_check_prune0_rule() const
   if (top_frame.prev == &top_frame)
     return false;
 
-  return !top_frame.eventualities.empty() &&
-         std::none_of(top_frame.eventualities.begin(),
-                      top_frame.eventualities.end(),
-                      [&, prev_frame_id](Eventuality ev) {
-                        if (ev.is_not_requested() || ev.is_not_satisfied())
-                          return false;
+  // No eventuality was satisfied after the previous frame
+  const Eventualities &evs = top_frame.eventualities;
+  if (evs.empty())
+    return false;
+  if (evs.satisfied_count() == 0 || evs.latest() <= prev_frame_id)
+    return true;
+  if (evs.earliest() > prev_frame_id)
+    return false;
 
-                        return ev.id() > prev_frame_id;
-                      });
+  for (size_t w = 0; w < evs.num_words(); ++w)
+    if (evs.satisfied_after(w, prev_frame_id))
+      return false;
+
+  return true;
 }
 
-bool Solver::_check_prune_rule() const
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_check_prune_rule() const
 {
   const Frame &top_frame = _stack.top();
 
   if (top_frame.prev == top_frame.first)
     return false;
 
-  uint64_t i = 0;
-  return std::all_of(
-    top_frame.eventualities.begin(), top_frame.eventualities.end(),
-    [&top_frame, &i](Eventuality ev) {
-      if (ev.is_not_requested() || ev.is_not_satisfied() ||
-          ev.id() <= top_frame.prev->id) {
-        ++i;
-        return true;
-      }
+  // Every eventuality satisfied after the previous frame had already been
+  // satisfied, at that frame, after the first one
+  const Eventualities &evs = top_frame.eventualities;
+  const Eventualities &prev_evs = top_frame.prev->eventualities;
+  if (evs.satisfied_count() == 0 || evs.latest() <= top_frame.prev->id)
+    return true;
 
-      bool ret = top_frame.prev->eventualities[i].is_satisfied() &&
-                 top_frame.prev->eventualities[i].id() > top_frame.first->id;
-      ++i;
-      return ret;
-    });
+  for (size_t w = 0; w < evs.num_words(); ++w)
+    if (evs.satisfied_after(w, top_frame.prev->id) &
+        ~prev_evs.satisfied_after(w, top_frame.first->id))
+      return false;
+
+  return true;
 }
 
-// This is probably not updating the solver stats correctly (what happens when
-// we pop a STEP frame?)
-void Solver::_rollback_to_latest_choice()
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_add_formula(Frame &frame, size_t formula,
+                                            uint64_t reason)
 {
-  while (!_stack.empty()) {
-    if (_stack.top().type == Frame::CHOICE &&
-        _stack.top().choosen_formula != FormulaID::max()) {
-      Frame &top = _stack.top();
-      ;
-      Frame new_frame(top);
-
-      if (_bitset.disjunction[top.choosen_formula])
-        new_frame.formulas[_rhs[top.choosen_formula]] = true;
-      else if (_bitset.eventually[top.choosen_formula]) {
-        new_frame.formulas[top.choosen_formula + 1] = true;
-        assert(_bitset.tomorrow[top.choosen_formula + 1] &&
-               _lhs[top.choosen_formula + 1] == top.choosen_formula);
-      }
-      else if (_bitset.until[top.choosen_formula]) {
-        new_frame.formulas[_lhs[top.choosen_formula]] = true;
-        if (_bitset.tomorrow[top.choosen_formula + 1]) {
-          new_frame.formulas[top.choosen_formula + 1] = true;
-          assert(_lhs[top.choosen_formula + 1] == top.choosen_formula);
-        }
-        else {
-          new_frame.formulas[top.choosen_formula + 2] = true;
-          assert(_lhs[top.choosen_formula + 2] == top.choosen_formula);
-        }
+  if (frame.formulas[formula])
+    return;
+
+  frame.formulas.set(formula);
+  frame.hash ^= _zobrist[formula];
+  _touch(formula);
+
+  const FormulaID complement = _complement[formula];
+  if (complement != FormulaID::max() && frame.formulas[complement])
+    _clash = true;
+
+  if (_options.learning)
+    _record_reason(frame, formula, reason);
+  if (_tracing())
+    _trail.push_back({Change::FORMULA, uint32_t(formula), FrameID()});
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_set_processed(Frame &frame, size_t formula)
+{
+  assert(frame.to_process[formula]);
+
+  frame.to_process.reset(formula);
+  _touch(formula);
+  if (_tracing())
+    _trail.push_back({Change::TO_PROCESS, uint32_t(formula), FrameID()});
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_set_eventuality(Frame &frame, size_t index,
+                                                Eventuality value)
+{
+  if (_tracing())
+    _trail.push_back(
+      {Change::EVENTUALITY, uint32_t(index), frame.eventualities[index].id()});
+
+  frame.eventualities.set(index, value);
+}
+
+// Reverts the changes in [begin, end) of the trail, newest first
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_undo(Frame &frame, size_t begin,
+                                    size_t end) const
+{
+  while (end > begin) {
+    const Change &change = _trail[--end];
+    switch (change.kind) {
+      case Change::FORMULA:
+        frame.formulas.reset(change.index);
+        frame.hash ^= _zobrist[change.index];
+        break;
+      case Change::TO_PROCESS:
+        frame.to_process.set(change.index);
+        break;
+      case Change::EVENTUALITY:
+        frame.eventualities.set(change.index, Eventuality(change.eventuality));
+        break;
+    }
+  }
+}
+
+// Popping frames, STEP ones included, leaves _stats alone: the frames and the
+// rules are counted as they are made or applied, never taken back
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_rollback_to_latest_choice()
+{
+  PROFILE_SCOPE(ROLLBACK);
+
+  auto pending = std::find_if(_choices.rbegin(), _choices.rend(),
+                              [](const Choice &c) { return c.pending; });
+
+  if (pending == _choices.rend()) {
+    _stack.clear();
+    _choices.clear();
+    _trail.clear();
+    _reason_trail.clear();
+    _forget_nogoods();
+    std::fill(_history.begin(), _history.end(), nullptr);
+    return;
+  }
+
+  Choice &choice = *pending;
+
+  // What was recorded in the states above the one of the choice goes away
+  // with their frames
+  for (auto it = pending.base(); it != _choices.end(); ++it) {
+    if (it->states > choice.states) {
+      _trail.resize(it->trail);
+      break;
+    }
+  }
+
+  _choices.erase(pending.base(), _choices.end());
+  if (_stack.size() > choice.states)
+    _touch_all();
+  else {
+    for (size_t i = choice.trail; i < _trail.size(); ++i)
+      if (_trail[i].kind != Change::EVENTUALITY)
+        _touch(_trail[i].index);
+  }
+
+  while (_stack.size() > choice.states) {
+    const bool closed = _stack.size() > _tainted;
+    _stack.pop();
+
+    Frame &step = _stack.top();
+    _forget(step);
+
+    // Every way out of the successor of the step ended in a contradiction
+    if (closed && _cache.enabled() && _depth() >= _cache_depth) {
+      _bitset.temporary = step.formulas;
+      _bitset.temporary &= _bitset.tomorrow;
+      if (_cache.insert(_bitset.temporary))
+        ++_stats.cache_evictions;
+    }
+  }
+  _tainted = std::min(_tainted, _stack.size());
+  _forget_nogoods();
+
+  Frame &top = _stack.top();
+  _undo(top, choice.trail, _trail.size());
+  _trail.resize(choice.trail);
+
+  while (_reason_trail.size() > choice.reasons) {
+    _reasons[_reason_trail.back().first] = _reason_trail.back().second;
+    _reason_trail.pop_back();
+  }
+
+  // Choices are only taken in frames without contradictions
+  _clash = false;
+
+  top.type = Frame::UNKNOWN;
+  top.first = nullptr;
+  top.prev = nullptr;
+  choice.pending = false;
+
+  if (choice.formula == FormulaID::max()) {
+    if (_next_expansion())
+      choice.pending = true;
+    else
+      _rollback_to_latest_choice();
+    return;
+  }
+
+  // Without a conflict found in the first alternative, the second one may
+  // follow from any choice taken before in the state
+  const uint64_t reason = choice.reason & _levels_below(choice.level);
+  _add_alternative(top, _alternative(choice.formula, false),
+                   _reason(choice.formula) | reason);
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_expand_state()
+{
+  const uint32_t none = std::numeric_limits<uint32_t>::max();
+  const size_t height = _stack.size();
+  if (_expansions.size() < height)
+    _expansions.resize(height);
+  if (!_expansions[height - 1]) {
+    _expansions[height - 1].reset(new Expansion());
+    _expansions[height - 1]->variable.assign(_number_of_formulas, none);
+    _expansions[height - 1]->selector.assign(_number_of_formulas, none);
+  }
+
+  Expansion &e = *_expansions[height - 1];
+  for (FormulaID f : e.formulas)
+    e.variable[f] = e.selector[f] = none;
+  e.formulas.clear();
+  e.sat.clear();
+
+  auto variable = [&e, none](FormulaID f) {
+    if (e.variable[f] == none) {
+      e.variable[f] = e.sat.new_variable();
+      e.formulas.push_back(f);
+    }
+    return SatSolver::positive(e.variable[f]);
+  };
+
+  const Frame &frame = _stack.top();
+  for (size_t f = frame.formulas.find_first(); f != Bitset::npos;
+       f = frame.formulas.find_next(f))
+    e.sat.add_clause({variable(FormulaID(f))});
+
+  // The rules of the formulas not processed yet, as implications from them
+  for (size_t i = 0; i < e.formulas.size(); ++i) {
+    const FormulaID f = e.formulas[i];
+    if (!frame.to_process[f])
+      continue;
+
+    const SatSolver::Literal absent = SatSolver::negative(e.variable[f]);
+    if (_bitset.conjunction[f] || _bitset.always[f]) {
+      e.sat.add_clause({absent, variable(_lhs[f])});
+      e.sat.add_clause(
+        {absent, variable(_bitset.conjunction[f] ? _rhs[f] : f + 1)});
+    }
+    else if (_bitset.beta[f]) {
+      // The first alternatives first, and the alternatives before the
+      // formulas, which then follow from them: the models come in the order
+      // of Branching::FIXED
+      const uint32_t kind = _bitset.disjunction[f]
+                              ? 3
+                              : _bitset.eventually[f] ? 2 : _bitset.until[f];
+      e.selector[f] = e.sat.new_variable(
+        true, uint32_t(kind * _number_of_formulas + (_number_of_formulas - f)));
+      for (bool first : {true, false}) {
+        const auto alternative = _alternative(f, first);
+        const SatSolver::Literal other = first
+                                           ? SatSolver::negative(e.selector[f])
+                                           : SatSolver::positive(e.selector[f]);
+        e.sat.add_clause({absent, other, variable(alternative.first)});
+        if (alternative.second != FormulaID::max())
+          e.sat.add_clause({absent, other, variable(alternative.second)});
       }
-      else if (_bitset.release[top.choosen_formula])
-      {
-        new_frame.formulas[_rhs[top.choosen_formula]] = true;
-        if (_bitset.tomorrow[top.choosen_formula + 1]) {
-			if (_lhs[top.choosen_formula + 1] == top.choosen_formula)
-				new_frame.formulas[top.choosen_formula + 1] = true;
-			else
-				new_frame.formulas[top.choosen_formula + 2] = true;
-        }
-        else {
-          new_frame.formulas[top.choosen_formula + 2] = true;
-          assert(_lhs[top.choosen_formula + 2] == top.choosen_formula);
-        }
+    }
+  }
+
+  for (FormulaID f : e.formulas) {
+    const FormulaID complement = _complement[f];
+    if (complement != FormulaID::max() && complement > f &&
+        e.variable[complement] != none)
+      e.sat.add_clause({SatSolver::negative(e.variable[f]),
+                        SatSolver::negative(e.variable[complement])});
+  }
+
+  if (!e.sat.solve())
+    return false;
+
+  _choices.push_back({FormulaID::max(), _trail.size(), height, true, 0,
+                      ~uint64_t(0), _reason_trail.size()});
+  _apply_expansion(e);
+
+  ++_stats.total_frames;
+  _stats.maximum_frames =
+    std::max(_stats.maximum_frames, static_cast<uint64_t>(_depth()));
+
+  return true;
+}
+
+// Called by _rollback_to_latest_choice() on the frame of the state as it was
+// before the model explored last
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_next_expansion()
+{
+  Expansion &e = *_expansions[_stack.size() - 1];
+  if (!e.sat.add_clause(e.blocking) || !e.sat.solve())
+    return false;
+
+  _apply_expansion(e);
+  return true;
+}
+
+// Applies the rules to the top frame taking the alternatives of the model,
+// which adds only formulas true in it
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_apply_expansion(Expansion &e)
+{
+  Frame &frame = _stack.top();
+  e.blocking.clear();
+
+  _lookahead_work.clear();
+  for (FormulaID f : e.formulas)
+    if (frame.formulas[f])
+      _lookahead_work.push_back(f);
+
+  while (!_lookahead_work.empty()) {
+    const FormulaID f = _lookahead_work.back();
+    _lookahead_work.pop_back();
+    if (!frame.to_process[f] || !(_bitset.alpha[f] || _bitset.beta[f]))
+      continue;
+
+    _set_processed(frame, f);
+
+    std::pair<FormulaID, FormulaID> alternative;
+    if (_bitset.conjunction[f])
+      alternative = {_lhs[f], _rhs[f]};
+    else if (_bitset.always[f])
+      alternative = {_lhs[f], f + 1};
+    else {
+      const bool first = e.sat.value(e.selector[f]);
+      e.blocking.push_back(first ? SatSolver::negative(e.selector[f])
+                                 : SatSolver::positive(e.selector[f]));
+      _request_eventuality(frame, f);
+      alternative = _alternative(f, first);
+    }
+
+    _add_alternative(frame, alternative, 0);
+    _lookahead_work.push_back(alternative.first);
+    if (alternative.second != FormulaID::max())
+      _lookahead_work.push_back(alternative.second);
+  }
+
+  assert(!_clash);
+  ++_stats.expansions;
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_request_eventuality(Frame &frame,
+                                                    FormulaID one)
+{
+  if ((Features & FEATURE_EVENTUALITIES) &&
+      (_bitset.eventually[one] || _bitset.until[one])) {
+    const FormulaID goal = _bitset.eventually[one] ? _lhs[one] : _rhs[one];
+    const size_t ev = _fw_eventualities_lut[goal];
+    if (__builtin_expect(frame.eventualities[ev].is_not_requested(), 0))
+      _set_eventuality(frame, ev, Eventuality::not_satisfied());
+  }
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_backjump()
+{
+  if (!_options.learning) {
+    _rollback_to_latest_choice();
+    return;
+  }
+
+  const uint64_t conflict = _conflict;
+
+  for (auto it = _choices.rbegin();
+       it != _choices.rend() && it->states == _stack.size(); ++it) {
+    if (conflict & _level_bit(it->level)) {
+      // The second alternative of the latest choice that led to the
+      // contradiction is the next one to explore, and it follows from the
+      // other choices that did
+      if (it->pending) {
+        it->reason = conflict & _levels_below(it->level);
+        _learn(conflict);
       }
-      else
-        assert(false);
+      break;
+    }
+
+    if (it->pending) {
+      it->pending = false;
+      ++_stats.backjumps;
+    }
+  }
+
+  _rollback_to_latest_choice();
+}
 
-      top.choosen_formula = FormulaID::max();
-      _stack.push(std::move(new_frame));
+// Records the first alternatives of the given choices of the top state as a
+// nogood, if they are few enough
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_learn(uint64_t conflict)
+{
+  const size_t local = _local_choices();
+  if (!conflict || (conflict >> 63) || local > 63 ||
+      _nogoods.size() >= MAX_NOGOODS)
+    return;
+
+  const size_t first = _choices.size() - local;
+  Nogood nogood;
+  nogood.size = 0;
+  nogood.states = _stack.size();
+
+  auto add = [&nogood](FormulaID f) {
+    if (std::find(nogood.formulas.begin(), nogood.formulas.begin() + nogood.size,
+                  f) != nogood.formulas.begin() + nogood.size)
+      return true;
+    if (nogood.size == MAX_NOGOOD_SIZE)
+      return false;
+    nogood.formulas[nogood.size++] = f;
+    return true;
+  };
+
+  for (uint64_t bits = conflict; bits; bits &= bits - 1) {
+    const size_t level = count_trailing_zeros(bits);
+    if (level >= local || !_choices[first + level].pending)
+      return;
 
+    const auto alternative = _alternative(_choices[first + level].formula, true);
+    if (!add(alternative.first) ||
+        (alternative.second != FormulaID::max() && !add(alternative.second)))
+      return;
+  }
+
+  for (size_t i = 0; i < nogood.size; ++i) {
+    _watches[nogood.formulas[i]].push_back(uint32_t(_nogoods.size()));
+    _bitset.watched.set(nogood.formulas[i]);
+  }
+  _nogoods.push_back(nogood);
+  ++_stats.nogoods;
+}
+
+// Records why the formula was just added to the top frame, and why it closes
+// the frame if it does
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_record_reason(const Frame &frame,
+                                              size_t formula, uint64_t reason)
+{
+  if (reason) {
+    _reason_trail.push_back({FormulaID(formula), _reasons[formula]});
+    _reasons[formula] = {reason, _stack.size()};
+  }
+
+  const FormulaID complement = _complement[formula];
+  if (complement != FormulaID::max() && frame.formulas[complement])
+    _conflict = reason | _reason(complement);
+
+  if (!_bitset.watched[formula])
+    return;
+
+  // It may complete a nogood of the top state, the last ones learned
+  const std::vector<uint32_t> &watches = _watches[formula];
+  for (auto it = watches.rbegin(); it != watches.rend(); ++it) {
+    const Nogood &nogood = _nogoods[*it];
+    if (nogood.states != _stack.size())
+      return;
+
+    uint64_t conflict = 0;
+    size_t present = 0;
+    while (present < nogood.size && frame.formulas[nogood.formulas[present]])
+      conflict |= _reason(nogood.formulas[present++]);
+
+    if (present == nogood.size) {
+      _clash = true;
+      _conflict = conflict;
       return;
     }
+  }
+}
 
-    _stack.pop();
+// The nogoods learned in the states no longer on the stack
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_forget_nogoods()
+{
+  while (!_nogoods.empty() && _nogoods.back().states > _stack.size()) {
+    const Nogood &nogood = _nogoods.back();
+    for (size_t i = 0; i < nogood.size; ++i) {
+      const FormulaID f = nogood.formulas[i];
+      _watches[f].pop_back();
+      if (_watches[f].empty())
+        _bitset.watched.reset(f);
+    }
+    _nogoods.pop_back();
   }
 }
 
-ModelPtr Solver::model()
+template <size_t Words, unsigned Features>
+uint64_t Tableau<Words, Features>::_reason(size_t formula) const
+{
+  if (!_options.learning)
+    return 0;
+
+  const Reason &reason = _reasons[formula];
+  return reason.states == _stack.size() ? reason.choices : 0;
+}
+
+template <size_t Words, unsigned Features>
+size_t Tableau<Words, Features>::_local_choices() const
+{
+  return !_choices.empty() && _choices.back().states == _stack.size()
+           ? _choices.back().level + 1
+           : 0;
+}
+
+template <size_t Words, unsigned Features>
+FormulaID Tableau<Words, Features>::_postponed(FormulaID one) const
+{
+  if (_bitset.eventually[one]) {
+    assert(_bitset.tomorrow[one + 1] && _lhs[one + 1] == one);
+    return one + 1;
+  }
+
+  if (_bitset.until[one] && _bitset.tomorrow[one + 1]) {
+    assert(_lhs[one + 1] == one);
+    return one + 1;
+  }
+
+  if (_bitset.release[one] && _bitset.tomorrow[one + 1] &&
+      _lhs[one + 1] == one)
+    return one + 1;
+
+  assert(_lhs[one + 2] == one);
+  return one + 2;
+}
+
+template <size_t Words, unsigned Features>
+std::pair<FormulaID, FormulaID>
+Tableau<Words, Features>::_alternative(FormulaID one, bool first) const
+{
+  const FormulaID none = FormulaID::max();
+
+  if (_bitset.disjunction[one])
+    return {first ? _lhs[one] : _rhs[one], none};
+  if (_bitset.eventually[one])
+    return {first ? _lhs[one] : _postponed(one), none};
+  if (_bitset.until[one])
+    return first ? std::make_pair(_rhs[one], none)
+                 : std::make_pair(_lhs[one], _postponed(one));
+
+  assert(_bitset.release[one]);
+  return first ? std::make_pair(_lhs[one], _rhs[one])
+               : std::make_pair(_rhs[one], _postponed(one));
+}
+
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::_add_alternative(
+  Frame &frame, std::pair<FormulaID, FormulaID> alternative, uint64_t reason)
+{
+  _add_formula(frame, alternative.first, reason);
+  if (alternative.second != FormulaID::max())
+    _add_formula(frame, alternative.second, reason);
+}
+
+template <size_t Words, unsigned Features>
+bool Tableau<Words, Features>::_fails(
+  std::pair<FormulaID, FormulaID> alternative)
+{
+  Bitset &formulas = _bitset.lookahead;
+  formulas = _stack.top().formulas;
+
+  _lookahead_work.clear();
+  _lookahead_work.push_back(alternative.first);
+  if (alternative.second != FormulaID::max())
+    _lookahead_work.push_back(alternative.second);
+
+  // The alpha formulas already in the frame are expanded in both alternatives
+  // anyway, only the new ones matter
+  while (!_lookahead_work.empty()) {
+    const FormulaID f = _lookahead_work.back();
+    _lookahead_work.pop_back();
+    if (formulas[f])
+      continue;
+
+    formulas.set(f);
+    const FormulaID complement = _complement[f];
+    if (complement != FormulaID::max() && formulas[complement])
+      return true;
+
+    if (_bitset.conjunction[f]) {
+      _lookahead_work.push_back(_lhs[f]);
+      _lookahead_work.push_back(_rhs[f]);
+    }
+    else if (_bitset.always[f]) {
+      _lookahead_work.push_back(_lhs[f]);
+      _lookahead_work.push_back(f + 1);
+    }
+  }
+
+  return false;
+}
+
+template <size_t Words, unsigned Features>
+ModelPtr Tableau<Words, Features>::model()
 {
   if (_state != State::PAUSED)
     return nullptr;
@@ -774,17 +2829,8 @@ ModelPtr Solver::model()
 
   ModelPtr model = std::make_shared<Model>();
 
-  if (_subformulas.size() == 1 && isa<True>(_subformulas[0])) {
-    model->loop_state = 0;
-    model->states.push_back({Literal(u8"\u22a4")});
-    return model;
-  }
-
   uint64_t i = 0;
-  for (const auto &frame : Container(_stack)) {
-    if (frame.type == Frame::CHOICE)
-      continue;
-
+  for (const auto &frame : _stack) {
     LTL::detail::State state;
     for (uint64_t j = 0; j < _number_of_formulas; ++j) {
       if (frame.formulas[j]) {
@@ -804,6 +2850,7 @@ ModelPtr Solver::model()
   if (_stack.top().id != 0)
     model->states.pop_back();
   model->loop_state = _loop_state;
+  _stats.current_model_size = model->states.size();
 
   return model;
 }
@@ -813,6 +2860,45 @@ FormulaPtr inline Solver::Formula() const
   return _formula;
 }
 
+Solver::Estimate Solver::estimate(uint32_t probes, uint32_t jobs)
+{
+  if (!_tableau)
+    return Estimate();
+
+  return _tableau->estimate(probes, jobs);
+}
+
+Solver::Result Solver::solution()
+{
+  if (!_tableau || _state == State::DONE)
+    return _result;
+
+  _result = _tableau->solution();
+  _state = _tableau->state();
+
+  // The tableau times the search only, the other phases are timed here
+  Stats::Timings seconds = _stats.seconds;
+  seconds.search = _tableau->stats().seconds.search;
+  _stats = _tableau->stats();
+  _stats.seconds = seconds;
+
+  _print_stats();
+
+  return _result;
+}
+
+ModelPtr Solver::model()
+{
+  if (!_tableau)
+    return nullptr;
+
+  Stopwatch stopwatch(_stats.seconds.model);
+  ModelPtr model = _tableau->model();
+  _stats.current_model_size = _tableau->stats().current_model_size;
+
+  return model;
+}
+
 void Solver::_print_stats() const
 {
 	format::debug("Total frames: {}", _stats.total_frames);
@@ -821,32 +2907,160 @@ void Solver::_print_stats() const
 	format::debug("Cross by contradiction: {}",
 				  _stats.cross_by_contradiction);
 	format::debug("Cross by prune: {}", _stats.cross_by_prune);
-	if (getenv("JOB_NO"))
-		std::cout << "JOB_NO="<<getenv("JOB_NO")<<" ";
-	std::cout << "WIDTH ";
-	for(int i=1;i<1000&&width[i];++i) {
-		std::cout << i << ":" << width[i] << " ";
-	} 
-        std::cout << "\n^0:" << clock() << std::endl;
-
-	const char* job_no="";
-	if (getenv("JOB_NO")) job_no=getenv("JOB_NO");
-	std::stringstream stream;
-	if (_result == Result::SATISFIABLE) {
-		stream << "IsSat!" 
-			<< " JOB="<<job_no<< " SEC=" << (double)clock()/1000000 << std::endl; 
-		std::cerr << stream.str();
-		exit(5);
-	}
-	if (_result == Result::UNSATISFIABLE) {
-		stream << "Unsat!"
-			<< " JOB="<<job_no<< " SEC=" << (double)clock()/1000000 << std::endl; 
+	format::debug("Cross by maximum depth: {}", _stats.cross_by_depth);
+	format::debug("Left to the other jobs: {}", _stats.cross_by_split);
+	format::debug("Cache hits: {}", _stats.cache_hits);
+	format::debug("Cache misses: {}", _stats.cache_misses);
+	format::debug("Cache evictions: {}", _stats.cache_evictions);
+	static const char *const branchings[] = {"fixed", "fewest-new",
+	                                         "eventualities", "activity"};
+	format::debug("Choices ({} branching): {}",
+				  branchings[static_cast<size_t>(_options.branching)],
+				  _stats.choices);
+	format::debug("Forced by lookahead: {}", _stats.forced_by_lookahead);
+	format::debug("Choices skipped by backjumping: {}", _stats.backjumps);
+	format::debug("Nogoods learned: {}", _stats.nogoods);
+	format::debug("States expanded by SAT: {}", _stats.expansions);
+
+	std::string rules;
+	for (size_t rule = 0; rule < Stats::NUMBER_OF_RULES; ++rule)
+		rules += format::format(
+		  " {}:{}", Stats::rule_name(Stats::Rule(rule)), _stats.rules[rule]);
+	format::debug("Rules applied:{}", rules);
+
+	std::string width;
+	for (size_t d = 1; d < _stats.width.size(); ++d)
+		width += format::format(" {}:{}", d, _stats.width[d]);
+	format::debug("Width:{}", width);
+
+	format::debug("Seconds: {:.3f} simplification, {:.3f} closure, {:.3f} "
+	              "tableau, {:.3f} search ({:.0f} frames/s)",
+	              _stats.seconds.simplification, _stats.seconds.closure,
+	              _stats.seconds.tableau, _stats.seconds.search,
+	              _stats.frames_per_second());
+
+	// Only in the builds with LEVIATHAN_PROFILE
+	for (size_t phase = 0; phase < Profile::NUMBER_OF_PHASES; ++phase) {
+		const Profile::Histogram &histogram = _stats.profile.phases[phase];
+		if (!histogram.runs)
+			continue;
+
+		std::string buckets;
+		for (size_t i = 0; i < 64; ++i)
+			if (histogram.buckets[i])
+				buckets += format::format(" 2^{}:{}", i, histogram.buckets[i]);
+		format::debug("Cycles of {}: {} runs, {:.0f} per run, by run:{}",
+		              Profile::phase_name(Profile::Phase(phase)),
+		              histogram.runs,
+		              double(histogram.cycles) / double(histogram.runs),
+		              buckets);
 	}
-	std::cerr << stream.str();
-    
+
+	// How the jobs of JOB_NO report to whoever gathers their answers
+	const char *job_no = getenv("JOB_NO");
+	if (!job_no)
+		return;
+
+	const char *result = _result == Result::SATISFIABLE
+	                       ? "IsSat!"
+	                       : _result == Result::UNSATISFIABLE
+	                           ? "Unsat!"
+	                           // Another job of the same JOB_POOL found a
+	                           // model, or Options::stop
+	                           : "Stopped!";
+	std::cerr << format::format("{} JOB={} SEC={}\n", result, job_no,
+	                            double(clock()) / CLOCKS_PER_SEC);
+}
+
+const char *Solver::Stats::rule_name(Rule rule)
+{
+  static const char *const names[NUMBER_OF_RULES] = {
+    "conjunction", "always", "disjunction", "eventually", "until",
+    "release",     "step",   "loop",        "prune0",     "prune"};
+  return names[rule];
+}
+
+std::string Solver::Stats::json() const
+{
+  std::ostringstream os;
+  os << "{\"total_frames\":" << total_frames
+     << ",\"maximum_frames\":" << maximum_frames
+     << ",\"maximum_model_size\":" << maximum_model_size
+     << ",\"current_model_size\":" << current_model_size
+     << ",\"frames_per_second\":" << frames_per_second()
+     << ",\"cross_by\":{\"contradiction\":" << cross_by_contradiction
+     << ",\"prune\":" << cross_by_prune << ",\"depth\":" << cross_by_depth
+     << ",\"split\":" << cross_by_split << "},\"cache\":{\"hits\":" << cache_hits
+     << ",\"misses\":" << cache_misses << ",\"evictions\":" << cache_evictions
+     << "},\"choices\":" << choices
+     << ",\"forced_by_lookahead\":" << forced_by_lookahead
+     << ",\"backjumps\":" << backjumps << ",\"nogoods\":" << nogoods
+     << ",\"expansions\":" << expansions << ",\"rules\":{";
+  for (size_t rule = 0; rule < NUMBER_OF_RULES; ++rule)
+    os << (rule ? "," : "") << '"' << rule_name(Rule(rule))
+       << "\":" << rules[rule];
+  os << "},\"width\":[";
+  for (size_t d = 0; d < width.size(); ++d)
+    os << (d ? "," : "") << width[d];
+  os << "],\"seconds\":{\"simplification\":" << seconds.simplification
+     << ",\"closure\":" << seconds.closure
+     << ",\"tableau\":" << seconds.tableau
+     << ",\"search\":" << seconds.search << ",\"model\":" << seconds.model
+     << "}";
+
+  if (!profile.empty()) {
+    os << ",\"profile\":{";
+    for (size_t phase = 0; phase < Profile::NUMBER_OF_PHASES; ++phase) {
+      const Profile::Histogram &histogram = profile.phases[phase];
+      size_t end = 64;
+      while (end > 0 && !histogram.buckets[end - 1])
+        --end;
+
+      os << (phase ? "," : "") << '"'
+         << Profile::phase_name(Profile::Phase(phase))
+         << "\":{\"runs\":" << histogram.runs
+         << ",\"cycles\":" << histogram.cycles << ",\"buckets\":[";
+      for (size_t i = 0; i < end; ++i)
+        os << (i ? "," : "") << histogram.buckets[i];
+      os << "]}";
+    }
+    os << "}";
+  }
+
+  os << "}";
+  return os.str();
+}
+
+const char *Solver::Profile::phase_name(Phase phase)
+{
+  static const char *const names[NUMBER_OF_PHASES] = {
+    "scan",    "alpha",  "beta", "contradiction", "eventualities",
+    "history", "loop",   "prune0", "prune",       "cache",
+    "step",    "rollback", "expansion"};
+  return names[phase];
+}
+
+bool Solver::Profile::empty() const
+{
+  for (const Histogram &histogram : phases)
+    if (histogram.runs)
+      return false;
+  return true;
+}
+
+Solver::Profile &Solver::Profile::operator+=(const Profile &other)
+{
+  for (size_t phase = 0; phase < NUMBER_OF_PHASES; ++phase) {
+    phases[phase].runs += other.phases[phase].runs;
+    phases[phase].cycles += other.phases[phase].cycles;
+    for (size_t i = 0; i < 64; ++i)
+      phases[phase].buckets[i] += other.phases[phase].buckets[i];
+  }
+  return *this;
 }
 
-void Solver::__dump_current_formulas() const
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::__dump_current_formulas() const
 {
   PrettyPrinter p;
   for (uint64_t i = 0; i < _subformulas.size(); ++i)
@@ -854,7 +3068,8 @@ void Solver::__dump_current_formulas() const
       format::verbose("{}", p.to_string(_subformulas[i]));
 }
 
-void Solver::__dump_current_eventualities() const
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::__dump_current_eventualities() const
 {
   PrettyPrinter p;
   for (uint64_t i = 0; i < _bw_eventualities_lut.size(); ++i)
@@ -862,7 +3077,8 @@ void Solver::__dump_current_eventualities() const
                     static_cast<uint64_t>(_stack.top().eventualities[i].id()));
 }
 
-void Solver::__dump_eventualities(FrameID id) const
+template <size_t Words, unsigned Features>
+void Tableau<Words, Features>::__dump_eventualities(FrameID id) const
 {
   PrettyPrinter p;
   Frame *current_frame = _stack.top().chain;
@@ -876,7 +3092,7 @@ void Solver::__dump_eventualities(FrameID id) const
   for (uint64_t i = 0; i < _bw_eventualities_lut.size(); ++i)
 	  format::verbose(
 		  "{} : {}", _subformulas[_bw_eventualities_lut[i]],
-		  static_cast<uint64_t>(Container(_stack)[id].eventualities[i].id()));
+		  static_cast<uint64_t>(_stack[id].eventualities[i].id()));
 }
 
 static bool formula_ordering_func(const FormulaPtr& a, const FormulaPtr& b)
@@ -0,0 +1,442 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "crossed_cache.hpp"
+#include "sat.hpp"
+#include "solver.hpp"
+#include "stack.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace LTL {
+namespace detail {
+
+class WorkPool;
+struct WorkItem;
+
+// What Solver needs from the tableau, whatever the width of its frames
+class TableauBase {
+public:
+  virtual ~TableauBase() {}
+
+  virtual Solver::Result solution() = 0;
+  virtual ModelPtr model() = 0;
+  virtual Solver::Estimate estimate(uint32_t probes, uint32_t jobs) = 0;
+
+  virtual Solver::State state() const = 0;
+  virtual const Solver::Stats &stats() const = 0;
+};
+
+// What a closure contains that the search has to deal with, as a mask
+enum Feature : unsigned {
+  // Eventually, until or release formulas, and so eventualities to satisfy
+  FEATURE_EVENTUALITIES = 1,
+
+  ALL_FEATURES = FEATURE_EVENTUALITIES
+};
+
+/*
+ * The tableau search on the closure built by Solver, with frames of Words
+ * 64-bit words. Solver::_initialize() picks the smallest width the closure
+ * fits in, or Words == 0 for the bitsets sized at runtime, and the Features
+ * it has: the rules and the bookkeeping of the others are compiled out.
+ */
+template <size_t Words, unsigned Features>
+class Tableau : public TableauBase {
+public:
+  using Frame = detail::Frame<Words>;
+  using Bitset = detail::Bitset<Words>;
+  using Stack = detail::stack<Frame, 64>;
+
+  using Result = Solver::Result;
+  using State = Solver::State;
+  using Stats = Solver::Stats;
+  using Options = Solver::Options;
+  using Branching = Solver::Branching;
+
+  explicit Tableau(const Solver &solver);
+
+  Tableau(const Tableau &) = delete;
+  Tableau &operator=(const Tableau &) = delete;
+
+  Result solution() override;
+  ModelPtr model() override;
+  Solver::Estimate estimate(uint32_t probes, uint32_t jobs) override;
+
+  State state() const override { return _state; }
+  const Stats &stats() const override { return _stats; }
+
+private:
+  // Builds a worker sharing the closure of the given tableau, used by the
+  // multi-threaded search
+  Tableau(const Tableau &master, WorkPool *pool);
+
+  Options _options;
+
+  State _state;
+  Result _result;
+
+  struct {
+    Bitset atom;
+    Bitset negation;
+    Bitset tomorrow;
+    Bitset always;
+    Bitset eventually;
+    Bitset conjunction;
+    Bitset disjunction;
+    Bitset until;
+    Bitset release;
+
+    // Every formula the alpha and the beta rules apply to
+    Bitset alpha;
+    Bitset beta;
+
+    // The alpha formulas with no beta formula below them, see _alpha_closure
+    Bitset beta_free;
+
+    // Every formula that satisfies an eventuality, see _bw_eventualities_lut
+    Bitset goal;
+
+    // The tomorrow formulas no successor shift covers, see _shifts
+    Bitset sparse_tomorrow;
+
+    /* This is used to do computations avoiding allocations */
+    Bitset temporary;
+
+    // The formulas of the top frame with those of an alternative, see _fails()
+    Bitset lookahead;
+
+    // The formulas of some nogood, see _nogoods
+    Bitset watched;
+  } _bitset;
+
+  std::vector<FormulaID> _lhs;
+  std::vector<FormulaID> _rhs;
+  std::unordered_map<FormulaID, std::string> _atom_set;
+
+  std::vector<FormulaID> _fw_eventualities_lut;
+  std::vector<FormulaID> _bw_eventualities_lut;
+
+  size_t _number_of_formulas;
+  FormulaID _start_index;
+  FrameID _loop_state;
+
+  std::vector<FormulaPtr> _subformulas;
+
+  // One frame per state of the current branch. The choices taken in a state
+  // change its frame in place, and the trail records how to undo them.
+  Stack _stack;
+
+  struct Choice {
+    FormulaID formula;
+    size_t trail;   // Size of the trail when the choice was taken
+    size_t states;  // Size of the stack when the choice was taken
+    bool pending;   // Is the second alternative still to be explored?
+    uint32_t level;  // How many choices were taken before in the same state
+    uint64_t reason;  // The choices the second alternative follows from
+    size_t reasons;   // Size of _reason_trail when the choice was taken
+  };
+
+  // With Options::learning, the choices of the top state each formula follows
+  // from, as a mask of their Choice::level (the last bit standing for all the
+  // levels from 63 on), to find which of them led to a contradiction. Only
+  // meaningful if set in a frame at the same height of the stack: the
+  // formulas already in the frame when the state was reached follow from
+  // none. Only written for formulas that follow from some choice, the old
+  // value going on the _reason_trail to be restored by
+  // _rollback_to_latest_choice().
+  struct Reason {
+    uint64_t choices;
+    size_t states;
+  };
+
+  std::vector<Reason> _reasons;
+  std::vector<std::pair<FormulaID, Reason>> _reason_trail;
+  uint64_t _conflict;  // The choices that led to the last contradiction
+
+  // The formulas whose first alternatives were found to lead to a
+  // contradiction together in a state, until the state is popped. Adding the
+  // last of them to its frame closes it at once. _bitset.watched marks the
+  // formulas found in some nogood, _watches lists the nogoods of each.
+  static constexpr size_t MAX_NOGOOD_SIZE = 4;
+  static constexpr size_t MAX_NOGOODS = 256;
+
+  struct Nogood {
+    std::array<FormulaID, MAX_NOGOOD_SIZE> formulas;
+    size_t size;
+    size_t states;
+  };
+  std::vector<Nogood> _nogoods;
+  std::vector<std::vector<uint32_t>> _watches;
+
+  struct Change {
+    enum Kind : uint8_t { FORMULA, TO_PROCESS, EVENTUALITY };
+
+    Kind kind;
+    uint32_t index;
+    FrameID eventuality;  // The value before the change, for EVENTUALITY
+  };
+
+  std::vector<Choice> _choices;
+  std::vector<Change> _trail;
+
+  // The states of the branch below the top one, in buckets by the hash of
+  // their formulas: the closest state first, the others following through
+  // Frame::same_bucket. There are always at least as many buckets as states.
+  std::vector<uint64_t> _zobrist;
+
+  // The STEP rule puts the argument of every tomorrow formula of a state in
+  // the next one. The ordering of the closure puts X φ shortly after φ, so
+  // the tomorrow formulas at the same distance from their argument are moved
+  // together, shifting the masked words by that distance.
+  struct Shift {
+    size_t distance;
+    Bitset mask;
+  };
+
+  static constexpr size_t MAX_SHIFTS = 8;
+  std::vector<Shift> _shifts;
+
+  // For each alpha formula in _bitset.beta_free, itself and every formula the
+  // alpha rules add to a frame containing it, applying them to what they add
+  // too. Empty for the other formulas.
+  std::vector<Bitset> _alpha_closure;
+
+  // The negation of each formula and the argument of each negation, or
+  // FormulaID::max(). _add_formula() looks it up to notice a contradiction as
+  // soon as it appears in the top frame, and sets _clash until the frame is
+  // rolled back.
+  std::vector<FormulaID> _complement;
+  bool _clash;
+
+  // The formulas _fails() or _apply_expansion() still have to apply the rules
+  // to
+  std::vector<FormulaID> _lookahead_work;
+
+  // With Options::sat, the clauses each state of the branch was expanded
+  // with, by height of the stack: a variable for each formula the rules can
+  // add to its frame before the STEP, and for each beta formula a selector,
+  // true for its first alternative. A state is expanded with a model at a
+  // time, and the blocking clause of the one explored rules it out when the
+  // search comes back to the state. Its choice in _choices has formula
+  // FormulaID::max().
+  struct Expansion {
+    SatSolver sat;
+    std::vector<uint32_t> variable;
+    std::vector<uint32_t> selector;
+    std::vector<FormulaID> formulas;  // The ones with a variable
+    std::vector<SatSolver::Literal> blocking;
+  };
+  std::vector<std::unique_ptr<Expansion>> _expansions;
+  std::vector<Frame *> _history;
+
+  // The successors known to be closed, and how many states at the bottom of
+  // the branch have a subtree that was not closed by contradictions alone
+  // (because of PRUNE, the depth limit, a model or work given away). Only the
+  // states above are recorded in the cache when they are popped.
+  CrossedCache<Words> _cache;
+  size_t _tainted;
+
+  // The cache is only used from this depth on: above the split depth of
+  // JOB_NO, every job has to build the same states, whatever it crossed in
+  // its own share, so that they count them the same way
+  size_t _cache_depth;
+
+  // Scores of the formulas for Branching::ACTIVITY, bumped for the choices
+  // taken in a state found contradictory, by an increment growing over time
+  // so that recent contradictions weigh more
+  std::vector<double> _activity;
+  double _activity_increment;
+
+  Stats _stats;
+
+  WorkPool *_pool;
+  uint32_t _poll_counter;
+
+  // The frames after which the next checkpoint is due, see
+  // Options::checkpoint_interval
+  uint64_t _next_checkpoint;
+
+  // Set in the copies of the tableau estimate() descends at random: each
+  // choice takes one of its alternatives and is never taken back, and the
+  // nodes met stand for the 2^k nodes of the tree they could have been, k
+  // the choices above them. Summed over the descents.
+  struct Probe {
+    uint64_t random = 0;
+    size_t choices = 0;          // Above the last node met
+    uint64_t visited = 0;        // Nodes met
+    double nodes = 0;            // Nodes they stand for
+    std::vector<double> width;   // Those Stats::width counts, by depth
+
+    // False past the depth the descents stop at
+    inline bool visit(size_t depth, size_t above);
+  };
+  std::unique_ptr<Probe> _probe;
+
+  // The kinds of beta formulas the closure may have, as indices of the masks
+  // of _scan_frame(): disjunctions, then eventually, until and release
+  // formulas if there are any
+  static constexpr size_t BETA_KINDS =
+    Features & FEATURE_EVENTUALITIES ? 4 : 1;
+
+  // What the rules would find in the top frame, see _scan_rules()
+  struct RuleScan {
+    bool empty;
+    bool alpha;
+    FormulaID beta;  // The formula to branch on, or FormulaID::max()
+  };
+
+  // What _scan_rules() found in each word of the top frame when it last looked
+  // at it, as masks over the words so that the results are found without
+  // walking all of them. Only the words marked dirty since are looked at again.
+  // Frames of a fixed width are only a few words, cheaper to walk whole than
+  // to keep track of: the cache is only used by Tableau<0>.
+  struct ScanCache {
+    DynamicBitset dirty;
+    DynamicBitset any;
+    DynamicBitset alpha;
+    DynamicBitset beta[4];             // Words with a pending beta of each kind
+    std::vector<uint64_t> beta_bits[4];  // And the pending betas in each word
+  } _scanned;
+
+  inline RuleScan _scan_rules();
+  inline RuleScan _scan_frame() const;
+  inline void _rescan_word(size_t word);
+
+  // Marks the words _scan_rules() has to look at again after a change of the
+  // given formula in the top frame, or after a change of the top frame
+  inline void _touch(size_t formula);
+  void _touch_all();
+  bool _build_alpha_closure(size_t formula, std::vector<bool> &visited);
+  inline void _add_alpha_closure(Frame &frame, size_t formula);
+  inline void _apply_alpha_rules();
+  inline bool _apply_conjunction_rule();
+  inline bool _apply_always_rule();
+
+  FormulaID _choose_beta() const;
+  inline Stats::Rule _beta_rule(FormulaID formula) const;
+  size_t _new_formulas(const Frame &frame, FormulaID one) const;
+  void _bump_activity();
+
+  // The X formula that postpones an eventually, until or release formula to
+  // the next state, in the second alternative of its rule
+  inline FormulaID _postponed(FormulaID one) const;
+
+  // The formulas added to the frame by the first or the second alternative of
+  // the rule of a beta formula, the second one FormulaID::max() if only one
+  inline std::pair<FormulaID, FormulaID> _alternative(FormulaID one,
+                                                      bool first) const;
+  inline void _add_alternative(Frame &frame,
+                               std::pair<FormulaID, FormulaID> alternative,
+                               uint64_t reason);
+
+  // Whether an alternative contradicts the top frame already after the alpha
+  // rules, applied to a copy of its formulas only
+  inline bool _fails(std::pair<FormulaID, FormulaID> alternative);
+
+  inline void _rollback_to_latest_choice();
+
+  // Expands the top frame with the first model of its clauses, false if it has
+  // none, or with the next one after the model explored, see Expansion
+  bool _expand_state();
+  bool _next_expansion();
+  void _apply_expansion(Expansion &expansion);
+
+  // Marks the eventuality of an eventually or until formula as requested
+  inline void _request_eventuality(Frame &frame, FormulaID one);
+
+  // After a contradiction, skips the alternatives of the choices of the top
+  // state that did not lead to it, learns a nogood, and rolls back
+  inline void _backjump();
+  void _learn(uint64_t conflict);
+  void _record_reason(const Frame &frame, size_t formula, uint64_t reason);
+  void _forget_nogoods();
+
+  inline uint64_t _reason(size_t formula) const;
+  inline size_t _local_choices() const;
+  static uint64_t _level_bit(size_t level)
+  {
+    return uint64_t(1) << std::min<size_t>(level, 63);
+  }
+  static uint64_t _levels_below(size_t level)
+  {
+    return level > 63 ? ~uint64_t(0) : _level_bit(level) - 1;
+  }
+
+  // Called before the search leaves the subtree of each state of the branch
+  // without having seen all of it closed by contradictions
+  void _taint() { _tainted = _stack.size(); }
+
+  // Depth of the search tree, counting the choices taken along the branch
+  size_t _depth() const { return _stack.size() + _choices.size(); }
+
+  // Changes have to be recorded only once a choice is taken in the state
+  bool _tracing() const
+  {
+    return !_choices.empty() && _choices.back().states == _stack.size();
+  }
+
+  inline void _add_formula(Frame &frame, size_t formula, uint64_t reason);
+  inline void _set_processed(Frame &frame, size_t formula);
+  inline void _set_eventuality(Frame &frame, size_t index, Eventuality value);
+  inline void _undo(Frame &frame, size_t begin, size_t end) const;
+
+  Result _parallel_solution();
+  void _share_work();
+  bool _acquire_work();
+  bool _export_work(WorkItem &item, size_t lowest_frame);
+  void _import_work(const WorkItem &item);
+  // Are the frames of the item sized for this closure? Those read from a
+  // damaged file might not be
+  bool _fits(const WorkItem &item) const;
+
+  // The whole state of the search at the top of the main loop, with the
+  // variables of JOB_NO kept by the loop, see Options::checkpoint. A
+  // checkpoint of another closure or other options is not loaded, and leaves
+  // the tableau as it was.
+  void _save_checkpoint(uint32_t last_depth, uint32_t split_depth) const;
+  bool _load_checkpoint(uint32_t &last_depth, uint32_t &split_depth);
+
+  // Without the job, the one shared by all the jobs of JOB_NO, see JobPool
+  uint64_t _fingerprint(bool job = true) const;
+
+  inline void _update_eventualities_satisfaction();
+  inline void _update_history();
+  inline void _remember(Frame &frame);
+  inline void _forget(Frame &frame);
+  void _grow_history();
+  uint64_t _hash(const Frame &frame) const;
+
+  void _build_shifts();
+  inline void _build_successor(Frame &next) const;
+  inline bool _has_clash(const Frame &frame) const;
+
+  inline std::pair<bool, FrameID> _check_loop_rule() const;
+  inline bool _check_prune0_rule() const;
+  inline bool _check_prune_rule() const;
+
+  void __dump_current_formulas() const;
+  void __dump_current_eventualities() const;
+  void __dump_eventualities(FrameID id) const;
+};
+}
+}
@@ -28,6 +28,15 @@ inline const S &Container(const std::stack<T, S> &s)
   return Stack::Container(s);
 }
 
+template <class T, class S>
+inline S &Container(std::stack<T, S> &s)
+{
+  struct Stack : private std::stack<T, S> {
+    static S &Container(std::stack<T, S> &_s) { return _s.*&Stack::c; }
+  };
+  return Stack::Container(s);
+}
+
 template <class Cont>
 class const_reverse_wrapper {
   const Cont &container;
@@ -0,0 +1,322 @@
+#include "work_pool.hpp"
+
+#include "format.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#define mkdir(path, mode) _mkdir(path)
+#define rmdir _rmdir
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace LTL {
+namespace detail {
+
+// Bumped whenever the layout below changes
+static constexpr uint64_t WORK_ITEM_MAGIC = 0x4c56574f524b0002;
+
+// How long an idle job sleeps between two looks at the pool directory
+static constexpr auto IDLE_SLEEP = std::chrono::milliseconds(10);
+
+// The least a frame takes: the sizes of its bitsets and eventualities, and
+// its id and links
+static constexpr uint64_t MIN_FRAME_BYTES = 9 * sizeof(uint64_t);
+
+void write_word(std::ostream &os, uint64_t word)
+{
+  os.write(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+uint64_t read_word(std::istream &is)
+{
+  uint64_t word = 0;
+  is.read(reinterpret_cast<char *>(&word), sizeof(word));
+  return word;
+}
+
+uint64_t read_count(std::istream &is, uint64_t item_size)
+{
+  const uint64_t count = read_word(is);
+
+  const std::streampos here = is.tellg();
+  is.seekg(0, std::ios::end);
+  const std::streampos end = is.tellg();
+  is.seekg(here);
+
+  if (!is || here < 0 || end < here ||
+      count > uint64_t(end - here) / item_size) {
+    is.setstate(std::ios::failbit);
+    return 0;
+  }
+
+  return count;
+}
+
+Eventuality read_eventuality(std::istream &is)
+{
+  const Eventuality ev{FrameID(read_word(is))};
+  if (ev.is_satisfied() &&
+      uint64_t(ev.id()) >= std::numeric_limits<uint32_t>::max()) {
+    is.setstate(std::ios::failbit);
+    return Eventuality();
+  }
+
+  return ev;
+}
+
+void write_bitset(std::ostream &os, const DynamicBitset &bits)
+{
+  write_word(os, bits.size());
+  for (size_t i = 0; i < bits.num_words(); ++i)
+    write_word(os, bits.words()[i]);
+}
+
+void read_bitset(std::istream &is, DynamicBitset &bits)
+{
+  // No more bits than bytes left, which is loose but enough to stop a
+  // damaged size from taking all the memory
+  bits.resize(read_count(is, 1));
+  for (size_t i = 0; i < bits.num_words(); ++i)
+    bits.words()[i] = read_word(is);
+}
+
+void write_work_item(std::ostream &os, const WorkItem &item)
+{
+  write_word(os, WORK_ITEM_MAGIC);
+  write_word(os, item.fingerprint);
+  write_word(os, item.frames.size());
+
+  for (size_t i = 0; i < item.frames.size(); ++i) {
+    const Frame<0> &frame = item.frames[i];
+    const WorkItem::Links &links = item.links[i];
+
+    write_bitset(os, frame.formulas);
+    write_bitset(os, frame.to_process);
+
+    write_word(os, frame.eventualities.size());
+    for (size_t j = 0; j < frame.eventualities.size(); ++j)
+      write_word(os, frame.eventualities[j].id());
+
+    write_word(os, frame.id);
+    write_word(os, links.type);
+    write_word(os, links.choosen_formula);
+    write_word(os, links.chain);
+    write_word(os, links.first);
+    write_word(os, links.prev);
+  }
+}
+
+bool read_work_item(std::istream &is, WorkItem &item)
+{
+  if (read_word(is) != WORK_ITEM_MAGIC)
+    return false;
+
+  item.fingerprint = read_word(is);
+  uint64_t size = read_count(is, MIN_FRAME_BYTES);
+  item.frames.clear();
+  item.links.clear();
+  item.frames.reserve(size);
+  item.links.reserve(size);
+
+  for (uint64_t i = 0; i < size && is; ++i) {
+    DynamicBitset formulas, to_process;
+    read_bitset(is, formulas);
+    read_bitset(is, to_process);
+
+    Eventualities eventualities(read_count(is, sizeof(uint64_t)));
+    for (size_t j = 0; j < eventualities.size(); ++j)
+      eventualities.set(j, read_eventuality(is));
+
+    // Kept in 32 bits by the eventualities satisfied in the frame
+    FrameID id(read_word(is));
+    if (uint64_t(id) >= std::numeric_limits<uint32_t>::max())
+      is.setstate(std::ios::failbit);
+
+    Frame<0> frame(id, 0, Eventualities(), nullptr);
+    frame.formulas = std::move(formulas);
+    frame.to_process = std::move(to_process);
+    frame.eventualities = std::move(eventualities);
+    item.frames.push_back(frame);
+
+    WorkItem::Links links;
+    links.type = static_cast<FrameBase::Type>(read_word(is));
+    links.choosen_formula = FormulaID(read_word(is));
+    links.chain = read_word(is);
+    links.first = read_word(is);
+    links.prev = read_word(is);
+    item.links.push_back(links);
+
+    // Frames only link to themselves and to the ones below, and share the
+    // first frame of the loop with the previous one, as Tableau links them
+    auto below = [i](size_t link) {
+      return link == WorkItem::NONE || link <= i;
+    };
+    bool linked = links.type <= FrameBase::CHOICE && below(links.chain) &&
+                  below(links.first) && below(links.prev);
+    if (links.prev == WorkItem::NONE)
+      linked = linked && links.first == WorkItem::NONE;
+    else if (linked)
+      linked = links.first ==
+               (links.prev == i ? i : item.links[links.prev].first);
+    if (!linked)
+      is.setstate(std::ios::failbit);
+  }
+
+  return bool(is);
+}
+
+JobPool::JobPool(const std::string &directory, uint64_t fingerprint)
+  : _directory(format::format("{}/{:016x}", directory, fingerprint)),
+    _fingerprint(fingerprint),
+    _pid(std::to_string(getpid()))
+{
+  // Either may be there already
+  mkdir(directory.c_str(), 0777);
+  mkdir(_directory.c_str(), 0777);
+
+  _touch("busy." + _pid);
+}
+
+JobPool::~JobPool()
+{
+  _remove("busy." + _pid);
+  _remove("hungry." + _pid);
+
+  // Whoever is still in the pool keeps a marker until it leaves, see acquire()
+  if (!_list("busy.").empty() || !_list("hungry.").empty())
+    return;
+
+  for (const char *prefix : {"work.", "tmp.", "claimed."})
+    for (const auto &name : _list(prefix))
+      _remove(name);
+  _remove("sat");
+
+  rmdir(_directory.c_str());
+}
+
+bool JobPool::hungry() const
+{
+  return _list("hungry.").size() > _list("work.").size();
+}
+
+void JobPool::offer(const WorkItem &item)
+{
+  std::string name = _pid + "." + std::to_string(_sequence++);
+
+  {
+    std::ofstream file(_path("tmp." + name), std::ios::binary);
+    write_work_item(file, item);
+  }
+
+  std::rename(_path("tmp." + name).c_str(), _path("work." + name).c_str());
+}
+
+bool JobPool::acquire(WorkItem &item)
+{
+  const std::string busy = "busy." + _pid;
+  const std::string hungry = "hungry." + _pid;
+  const std::string claimed = "claimed." + _pid;
+
+  // Never without a marker, or the last job to leave could clear the pool
+  // under us
+  _touch(hungry);
+  _remove(busy);
+
+  while (!stopped()) {
+    std::vector<std::string> work = _list("work.");
+
+    for (const auto &name : work) {
+      // Mark ourselves busy before claiming, so that nobody can see the work
+      // gone and no job busy at the same time
+      _touch(busy);
+      if (std::rename(_path(name).c_str(), _path(claimed).c_str()) != 0) {
+        _remove(busy);
+        continue;
+      }
+
+      bool ok = false;
+      {
+        std::ifstream file(_path(claimed), std::ios::binary);
+        // Left by a run of another formula that did not clean up after
+        // itself, e.g. because it was killed
+        ok = read_work_item(file, item) && item.fingerprint == _fingerprint;
+      }
+      _remove(claimed);
+
+      if (ok) {
+        _remove(hungry);
+        return true;
+      }
+
+      _remove(busy);
+    }
+
+    // Work can only be offered by busy jobs, and a job that stops being busy
+    // looks for work itself, so nothing can get lost after this point
+    if (work.empty() && _list("busy.").empty())
+      break;
+
+    std::this_thread::sleep_for(IDLE_SLEEP);
+  }
+
+  _remove(hungry);
+  return false;
+}
+
+void JobPool::satisfiable()
+{
+  _touch("sat");
+}
+
+bool JobPool::stopped() const
+{
+  return std::ifstream(_path("sat")).good();
+}
+
+std::string JobPool::_path(const std::string &name) const
+{
+  return _directory + "/" + name;
+}
+
+std::vector<std::string> JobPool::_list(const std::string &prefix) const
+{
+  std::vector<std::string> names;
+
+#ifndef _MSC_VER
+  DIR *dir = opendir(_directory.c_str());
+  if (!dir)
+    return names;
+
+  while (dirent *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, prefix.size(), prefix) == 0)
+      names.push_back(name);
+  }
+
+  closedir(dir);
+#endif
+
+  return names;
+}
+
+void JobPool::_touch(const std::string &name) const
+{
+  std::ofstream(_path(name));
+}
+
+void JobPool::_remove(const std::string &name) const
+{
+  std::remove(_path(name).c_str());
+}
+}
+}
@@ -0,0 +1,146 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+#pragma once
+
+#include "frame.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace LTL {
+namespace detail {
+
+/*
+ * A subtree handed over from one worker to another: the frames of the states
+ * from the root up to a choice whose second alternative has not been explored
+ * yet, the last one as it was when the choice was taken.
+ * Pointers between frames are stored as indices in the vector, so that they
+ * can be rebuilt in the stack of the receiving worker. The frames are kept at
+ * runtime width, so that the format does not depend on the instantiation of
+ * the tableau.
+ */
+struct WorkItem {
+  static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+  struct Links {
+    FrameBase::Type type;
+    FormulaID choosen_formula;
+    size_t chain;
+    size_t first;
+    size_t prev;
+  };
+
+  // Of the formula and options the subtree belongs to, see JobPool
+  uint64_t fingerprint = 0;
+
+  std::vector<Frame<0>> frames;
+  std::vector<Links> links;
+};
+
+// Binary (de)serialization of work items, used to move them between processes
+void write_work_item(std::ostream &os, const WorkItem &item);
+bool read_work_item(std::istream &is, WorkItem &item);
+
+// The pieces they are made of, also used by the checkpoints of Tableau
+void write_word(std::ostream &os, uint64_t word);
+uint64_t read_word(std::istream &is);
+// A number of items taking at least item_size bytes each in the rest of the
+// stream, which fails instead if they cannot be there, e.g. in a damaged file
+uint64_t read_count(std::istream &is, uint64_t item_size);
+// An eventuality, which fails for a frame id Eventualities cannot hold
+Eventuality read_eventuality(std::istream &is);
+void write_bitset(std::ostream &os, const DynamicBitset &bits);
+void read_bitset(std::istream &is, DynamicBitset &bits);
+
+/*
+ * State shared by the workers of a multi-threaded search. Idle workers
+ * announce themselves through the hungry counter, which busy workers poll
+ * and answer by exporting the bottom-most unexplored alternative of their
+ * stack, i.e. the biggest subtree they have.
+ */
+class WorkPool {
+public:
+  explicit WorkPool(uint32_t workers) : workers(workers) {}
+
+  std::mutex mutex;
+  std::condition_variable available;
+  std::deque<WorkItem> items;
+
+  std::atomic<uint32_t> hungry{0};
+  std::atomic<bool> done{false};
+
+  const uint32_t workers;
+  uint32_t idle = 0;
+};
+
+/*
+ * Cross-process counterpart of WorkPool, for the jobs of a JOB_NO run on the
+ * same machine. Each formula gets its own subdirectory of the shared one
+ * (JOB_POOL), named after the fingerprint of the formula and of the options,
+ * holding one marker file per job, busy.<pid> or hungry.<pid>, and the
+ * exported subtrees as work.<pid>.<n> files, which are published and claimed
+ * with atomic renames. A job that has finished its own share claims work from
+ * the others, and gives up only when no work file is left and no job is busy
+ * anymore. The last job to leave removes the subdirectory, so that later
+ * formulas and later runs start from an empty one.
+ */
+class JobPool {
+public:
+  JobPool(const std::string &directory, uint64_t fingerprint);
+  ~JobPool();
+
+  JobPool(const JobPool &) = delete;
+  JobPool &operator=(const JobPool &) = delete;
+
+  // Is any job waiting for work that nobody has offered yet?
+  bool hungry() const;
+
+  // The item should carry the fingerprint of the pool, the others are
+  // discarded by acquire()
+  void offer(const WorkItem &item);
+
+  // Blocks until some work is available. Returns false when the whole run is
+  // over, either because everything has been explored or because a job found
+  // a model (see stopped())
+  bool acquire(WorkItem &item);
+
+  // Tells the other jobs that a model has been found
+  void satisfiable();
+  bool stopped() const;
+
+  uint64_t fingerprint() const { return _fingerprint; }
+
+private:
+  std::string _directory;
+  uint64_t _fingerprint;
+  std::string _pid;
+  uint64_t _sequence = 0;
+
+  std::string _path(const std::string &name) const;
+  std::vector<std::string> _list(const std::string &prefix) const;
+  void _touch(const std::string &name) const;
+  void _remove(const std::string &name) const;
+};
+}
+}
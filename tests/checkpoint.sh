@@ -0,0 +1,115 @@
+#!/bin/bash
+
+#
+# This script checks that a search saved by --checkpoint continues with
+# --resume exactly where it stopped, and that a checkpoint is not loaded by a
+# run with other options or when damaged. It is run by CTest as the
+# "checkpoint" test.
+#
+# Usage: tests/checkpoint.sh [checker]
+#
+
+die() {
+  echo \
+This script must be executed from the root directory of leviathan\'s source \
+tree. 1>&2
+  exit 1
+}
+
+fail() {
+  echo "checkpoint: $@" 1>&2
+  exit 1
+}
+
+# Check that we run from the topmost source dir
+[ -d tests ] || die
+
+checker=${1:-bin/checker}
+dir=$(mktemp -d)
+trap "rm -rf $dir" EXIT
+
+# The total_frames of the n-th line of a --stats file
+frames() {
+  sed -n "${2}s/.*\"total_frames\":\([0-9]*\).*/\1/p" $1
+}
+
+# About 217000 frames: the only checkpoint is saved after 150000 of them, and
+# is left behind when the search ends, as if it had been killed right after
+formula=tests/trp/N5y/25/pltl-5-0-25-3-0-200009.pltl
+
+answer=$($checker --parsable --stats $dir/stats $formula)
+[ "$answer" = SAT ] || fail "uninterrupted run answered $answer"
+
+$checker --parsable --checkpoint $dir/saved --checkpoint-interval 150000 \
+  $formula > /dev/null
+[ -f $dir/saved ] || fail "no checkpoint saved"
+
+resumed=$($checker --parsable --resume $dir/saved --stats $dir/stats $formula \
+          2>&1)
+echo "$resumed" | grep -q "Resuming the search after" ||
+  fail "the checkpoint was not loaded"
+[ "$(echo "$resumed" | tail -n 1)" = "$answer" ] ||
+  fail "resumed run answered $(echo "$resumed" | tail -n 1)"
+[ "$(frames $dir/stats 1)" = "$(frames $dir/stats 2)" ] ||
+  fail "resumed run built $(frames $dir/stats 2) frames," \
+       "instead of $(frames $dir/stats 1)"
+
+# Another branching policy makes another tableau: the checkpoint is refused
+# and the search starts from scratch
+cp $dir/saved $dir/other
+other=$($checker --parsable --branching activity --resume $dir/other $formula \
+        2>&1)
+echo "$other" | grep -q "is not of this formula with these options" ||
+  fail "checkpoint loaded with another branching policy"
+[ "$(echo "$other" | tail -n 1)" = "$answer" ] ||
+  fail "run refusing the checkpoint answered $(echo "$other" | tail -n 1)"
+
+# A damaged checkpoint, cut short or with some bytes overwritten past the
+# header, is refused the same way instead of being loaded
+size=$(stat -c %s $dir/saved)
+head -c $((size / 2)) $dir/saved > $dir/damaged.0
+for offset in 40 $((size / 3)) $((size - 20)); do
+  cp $dir/saved $dir/damaged.$offset
+  printf '\377\377\377\377' |
+    dd of=$dir/damaged.$offset bs=1 seek=$offset conv=notrunc 2> /dev/null
+done
+for damaged in $dir/damaged.*; do
+  refused=$($checker --parsable --resume $damaged $formula 2>&1)
+  echo "$refused" | grep -q "is damaged, starting from scratch" ||
+    fail "damaged checkpoint $(basename $damaged) not refused"
+  [ "$(echo "$refused" | tail -n 1)" = "$answer" ] ||
+    fail "run refusing $(basename $damaged) answered" \
+         "$(echo "$refused" | tail -n 1)"
+done
+
+# Each formula of a file of several is saved on its own, after its line: here
+# only the first one runs long enough for a checkpoint
+{ cat $formula; echo; echo 'G a & F ~a'; } > $dir/batch.pltl
+$checker --parsable --checkpoint $dir/batch --checkpoint-interval 150000 \
+  $dir/batch.pltl > /dev/null
+[ -f $dir/batch.1 ] && [ ! -f $dir/batch ] && [ ! -f $dir/batch.2 ] ||
+  fail "batch checkpoints not saved per formula"
+
+batch=$($checker --parsable --resume $dir/batch $dir/batch.pltl 2>&1)
+[ "$(echo "$batch" | grep -c "Resuming the search after")" = 1 ] ||
+  fail "batch checkpoint of the first formula not loaded alone"
+[ "$(echo "$batch" | grep -vc "Resuming the search after")" = 2 ] ||
+  fail "unexpected output resuming a batch: $batch"
+[ "$(echo "$batch" | tail -n 2 | tr '\n' ' ')" = "$answer UNSAT " ] ||
+  fail "resumed batch answered $(echo "$batch" | tail -n 2 | tr '\n' ' ')"
+
+# A search stopped by a signal saves where it was, and goes on from there. This
+# formula takes much longer than the few seconds given to each run
+formula='G (a | b) & G F a & G F ~a & F G c'
+
+timeout -s TERM 1 $checker --parsable --checkpoint $dir/stopped \
+  --stats $dir/stopped.stats -l "$formula" > /dev/null
+[ -f $dir/stopped ] || fail "no checkpoint saved when stopped"
+
+timeout -s TERM 1 $checker --parsable --resume $dir/stopped \
+  --stats $dir/stopped.stats -l "$formula" > /dev/null 2>&1
+[ "$(frames $dir/stopped.stats 2)" -gt "$(frames $dir/stopped.stats 1)" ] ||
+  fail "resumed run did not go on from the $(frames $dir/stopped.stats 1)" \
+       "frames saved"
+
+exit 0
@@ -0,0 +1,95 @@
+#!/bin/bash
+
+#
+# This script checks the static split of JOB_NO: on some benchmarks of
+# tests.index, all the jobs of a run that go through the whole tableau have to
+# build the same number of states at the split depth, for them to share those
+# states out, and together they have to give the answer of tests.index. It is
+# run by CTest as the "job-split" test.
+#
+# Usage: tests/job-split.sh [checker] [options of the checker]
+#
+
+die() {
+  echo \
+This script must be executed from the root directory of leviathan\'s source \
+tree. 1>&2
+  exit 1
+}
+
+fail() {
+  echo "job-split: $@" 1>&2
+  exit 1
+}
+
+# Check that we run from the topmost source dir
+[ -d tests ] || die
+
+checker=${1:-bin/checker}
+shift
+dir=$(mktemp -d)
+trap "rm -rf $dir" EXIT
+
+jobs=3
+
+# The number of states built at the given depth, from a --stats file
+width() {
+  sed -n 's/.*"width":\[\([0-9,]*\)\].*/\1/p' $1 | cut -d, -f$(($2 + 1))
+}
+
+# One benchmark out of 40, to keep it quick, and one the cache of crossed
+# subtrees used to throw off
+awk 'NR % 40 == 1 || /O1formula2.pltl/' tests/tests.index |
+while IFS=";" read -r filename result; do
+  for depth in 4 8; do
+    pids=""
+    for job in $(seq 1 $jobs); do
+      rm -f $dir/stats.$job $dir/answer.$job
+      JOB_NO=$job/$jobs@$depth $checker --parsable --stats $dir/stats.$job \
+        "$@" $filename > $dir/answer.$job 2> /dev/null &
+      pids="$pids $!"
+    done
+
+    # As whoever gathers the answers would, stop every job at the first model:
+    # the shares without one can take much longer than the whole search
+    running=$pids
+    while [ -n "$running" ] && ! cat $dir/answer.* | grep -qx SAT; do
+      sleep 0.05
+      running=""
+      for pid in $pids; do
+        kill -0 $pid 2> /dev/null && running="$running $pid"
+      done
+    done
+    kill $pids 2> /dev/null
+    wait
+
+    answers=""
+    complete=""
+    for job in $(seq 1 $jobs); do
+      answer=$(cat $dir/answer.$job)
+      answers="$answers ${answer:-stopped}"
+
+      # Only these went through all the states of their share
+      [ "$answer" = UNSAT ] && complete="$complete $job"
+    done
+
+    first=""
+    for job in $complete; do
+      [ -z "$first" ] && first=$job
+      [ "$(width $dir/stats.$job $depth)" = "$(width $dir/stats.$first $depth)" ] ||
+        fail "$filename at depth $depth: job $job built" \
+             "$(width $dir/stats.$job $depth) states, job $first built" \
+             "$(width $dir/stats.$first $depth)"
+    done
+
+    # Unsatisfiable only if every share is
+    case "$answers" in
+      *" SAT"*) answer=SAT ;;
+      *stopped*|*UNKNOWN*) answer=UNKNOWN ;;
+      *) answer=UNSAT ;;
+    esac
+    [ "$answer" = "$result" ] ||
+      fail "$filename at depth $depth: the jobs answered$answers," \
+           "instead of $result"
+  done
+done
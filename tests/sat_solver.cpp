@@ -0,0 +1,257 @@
+/*
+  Copyright (c) 2014, Matteo Bertello
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+  * The names of its contributors may not be used to endorse or promote
+    products derived from this software without specific prior written
+    permission.
+*/
+
+/*
+ * Direct tests of the SAT solver used by --sat, run by ctest as sat_solver.
+ * The tests of tests.index only see it through the answers of the tableau.
+ */
+
+#include "sat.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using LTL::detail::SatSolver;
+using Clauses = std::vector<std::vector<SatSolver::Literal>>;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                     \
+  do {                                                                       \
+    if (!(condition)) {                                                      \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,  \
+                   #condition);                                              \
+      ++failures;                                                            \
+    }                                                                        \
+  } while (0)
+
+static uint64_t splitmix64(uint64_t &state)
+{
+  uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static bool satisfies(const std::vector<bool> &model, const Clauses &clauses)
+{
+  for (const auto &clause : clauses) {
+    bool satisfied = false;
+    for (SatSolver::Literal l : clause)
+      satisfied = satisfied || model[l / 2] == (l % 2 == 0);
+    if (!satisfied)
+      return false;
+  }
+
+  return true;
+}
+
+static std::vector<bool> model_of(const SatSolver &solver)
+{
+  std::vector<bool> model(solver.variables());
+  for (uint32_t v = 0; v < model.size(); ++v)
+    model[v] = solver.value(v);
+
+  return model;
+}
+
+// The implied literals are found without deciding on them
+static void test_unit_propagation()
+{
+  SatSolver solver;
+  uint32_t a = solver.new_variable();
+  uint32_t b = solver.new_variable();
+  uint32_t c = solver.new_variable();
+  uint32_t d = solver.new_variable(true);
+
+  CHECK(solver.add_clause({SatSolver::positive(a)}));
+  CHECK(solver.add_clause({SatSolver::negative(a), SatSolver::positive(b)}));
+  CHECK(solver.add_clause({SatSolver::negative(b), SatSolver::positive(c)}));
+  CHECK(solver.add_clause({SatSolver::negative(c), SatSolver::negative(d)}));
+
+  CHECK(solver.solve());
+  CHECK(solver.value(a) && solver.value(b) && solver.value(c));
+  CHECK(!solver.value(d));
+
+  // Contradicts what the unit clauses imply
+  solver.add_clause({SatSolver::negative(c)});
+  CHECK(!solver.solve());
+}
+
+// Deciding x0, x1, x2 and x3 false makes x4 both true and false. The conflict
+// depends on x0 and x3 alone, so the solver has to learn (x0 | x3) and jump
+// back over x1 and x2 to set x3, leaving them with their phase.
+static void test_conflict_analysis()
+{
+  SatSolver solver;
+  for (int i = 0; i < 5; ++i)
+    solver.new_variable();
+
+  CHECK(solver.add_clause({SatSolver::positive(0), SatSolver::positive(3),
+                           SatSolver::positive(4)}));
+  CHECK(solver.add_clause({SatSolver::positive(0), SatSolver::positive(3),
+                           SatSolver::negative(4)}));
+  CHECK(solver.add_clause({SatSolver::positive(1), SatSolver::negative(2),
+                           SatSolver::negative(4)}));
+
+  CHECK(solver.solve());
+  CHECK(model_of(solver) ==
+        std::vector<bool>({false, false, false, true, false}));
+
+  // Still with x0 false, and x3 true
+  solver.add_clause({SatSolver::positive(1), SatSolver::positive(2)});
+  CHECK(solver.solve());
+  CHECK(!solver.value(0) && solver.value(3));
+}
+
+// n + 1 pigeons cannot go in n holes, n can
+static void test_pigeonhole()
+{
+  for (uint32_t holes = 1; holes <= 6; ++holes) {
+    for (uint32_t pigeons = holes; pigeons <= holes + 1; ++pigeons) {
+      SatSolver solver;
+      Clauses clauses;
+      auto in = [holes](uint32_t p, uint32_t h) { return p * holes + h; };
+
+      for (uint32_t v = 0; v < pigeons * holes; ++v)
+        solver.new_variable();
+
+      for (uint32_t p = 0; p < pigeons; ++p) {
+        clauses.emplace_back();
+        for (uint32_t h = 0; h < holes; ++h)
+          clauses.back().push_back(SatSolver::positive(in(p, h)));
+      }
+
+      for (uint32_t h = 0; h < holes; ++h)
+        for (uint32_t p = 0; p < pigeons; ++p)
+          for (uint32_t q = p + 1; q < pigeons; ++q)
+            clauses.push_back({SatSolver::negative(in(p, h)),
+                               SatSolver::negative(in(q, h))});
+
+      for (const auto &clause : clauses)
+        solver.add_clause(clause);
+
+      const bool sat = solver.solve();
+      CHECK(sat == (pigeons == holes));
+      if (sat)
+        CHECK(satisfies(model_of(solver), clauses));
+    }
+  }
+}
+
+// Random 3-SAT against all the assignments: the models have to come one by
+// one from the greatest down, in the order of the priorities and with the
+// phases of the variables, when each one found is blocked
+static void test_enumeration()
+{
+  const uint32_t n = 10;
+  uint64_t state = 42;
+
+  SatSolver solver;
+  for (int round = 0; round < 300; ++round) {
+    solver.clear();
+
+    std::vector<bool> phase(n);
+    std::vector<uint32_t> priority(n);
+    for (uint32_t v = 0; v < n; ++v) {
+      phase[v] = splitmix64(state) & 1;
+      priority[v] = uint32_t(splitmix64(state) % 3);
+      solver.new_variable(phase[v], priority[v]);
+    }
+
+    Clauses clauses(20 + splitmix64(state) % 40);
+    for (auto &clause : clauses)
+      for (int i = 0; i < 3; ++i)
+        clause.push_back(SatSolver::Literal(splitmix64(state) % (2 * n)));
+
+    for (const auto &clause : clauses)
+      solver.add_clause(clause);
+
+    // The variables from the first decided to the last
+    std::vector<uint32_t> order(n);
+    for (uint32_t v = 0; v < n; ++v)
+      order[v] = v;
+    std::stable_sort(order.begin(), order.end(),
+                     [&priority](uint32_t v, uint32_t w) {
+                       return priority[v] > priority[w];
+                     });
+
+    // Greatest first: the key of an assignment has a bit set for each
+    // variable taking its phase, the first decided in the highest bit
+    std::vector<uint32_t> expected;
+    for (uint32_t key = 1u << n; key-- > 0;) {
+      std::vector<bool> model(n);
+      for (uint32_t i = 0; i < n; ++i)
+        model[order[i]] = bool(key >> (n - 1 - i) & 1) == phase[order[i]];
+      if (satisfies(model, clauses))
+        expected.push_back(key);
+    }
+
+    std::vector<uint32_t> found;
+    while (solver.solve() && found.size() <= expected.size()) {
+      std::vector<bool> model = model_of(solver);
+      CHECK(satisfies(model, clauses));
+
+      uint32_t key = 0;
+      std::vector<SatSolver::Literal> blocking;
+      for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t v = order[i];
+        key = key << 1 | uint32_t(model[v] == phase[v]);
+        blocking.push_back(model[v] ? SatSolver::negative(v)
+                                    : SatSolver::positive(v));
+      }
+      found.push_back(key);
+
+      if (!solver.add_clause(blocking))
+        break;
+    }
+
+    CHECK(found == expected);
+  }
+}
+
+// Nothing of the clauses before clear() is left
+static void test_clear()
+{
+  SatSolver solver;
+  solver.new_variable();
+  solver.add_clause({SatSolver::positive(0)});
+  solver.add_clause({SatSolver::negative(0)});
+  CHECK(!solver.solve());
+
+  solver.clear();
+  CHECK(solver.variables() == 0);
+  solver.new_variable();
+  solver.add_clause({SatSolver::negative(0)});
+  CHECK(solver.solve());
+  CHECK(!solver.value(0));
+}
+
+int main()
+{
+  test_unit_propagation();
+  test_conflict_analysis();
+  test_pigeonhole();
+  test_enumeration();
+  test_clear();
+
+  if (failures)
+    std::fprintf(stderr, "%d checks failed\n", failures);
+
+  return failures ? 1 : 0;
+}